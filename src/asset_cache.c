@@ -0,0 +1,120 @@
+/**
+	Asset Cache
+	  asset_cache.c
+
+	Scratch names every asset by the MD5 of its file, and the same assets turn up in a lot
+	of projects, since projects are remixed and costumes are shared. Decoding images is most
+	of the work of reading resources, so decoded images are kept in a directory, the asset
+	cache, with a file for each image named by its MD5. The next time an image with the
+	same MD5 is read, by any project, the bitmap is mapped out of the asset cache instead of
+	being decoded.
+
+	A file in the asset cache is a struct CachedBitmap followed by the RGBA pixels of the
+	image, exactly as SOIL decoded them, so that they can be uploaded right out of the
+	mapping. The MD5 comes from the project.json, rather than the file itself, so the CRC
+	and size of the file it was decoded from are kept too, and a bitmap is only used for a
+	file that matches them.
+
+	This file is included by zip_loader.c.
+**/
+
+#include <limits.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#endif
+
+#define CACHE_MAGIC "SB2PIXEL"
+#define CACHE_VERSION 1
+
+struct CachedBitmap {
+	char magic[8];
+	uint32 version;
+	uint32 crc; // of the file the bitmap was decoded from
+	uint64_t sourceSize; // of the file the bitmap was decoded from
+	uint32 width, height;
+};
+
+/* Starts using the directory at path as the asset cache, making it if it doesn't exist.
+	 NULL turns the asset cache off. */
+static void openAssetCache(const char *const path) {
+	assetCachePath = path;
+	if(path == NULL)
+		return;
+#ifdef _WIN32
+	_mkdir(path);
+#else
+	mkdir(path, 0777);
+#endif
+}
+
+/* Makes the path of the file in the asset cache of an entry, with suffix on the end.
+	 Returns NULL if the entry isn't cached. */
+static char *cachedPath(const struct Entry *const e, const char *const suffix) {
+	if(assetCachePath == NULL || e->hash[0] == '\0')
+		return NULL;
+	const size_t len = strlen(assetCachePath) + 1 + sizeof(e->hash) + strlen(suffix) + sizeof(".rgba");
+	char *const path = malloc(len);
+	if(path != NULL)
+		snprintf(path, len, "%s/%s.rgba%s", assetCachePath, e->hash, suffix);
+	return path;
+}
+
+/* Maps the bitmap of an entry out of the asset cache into its data. Returns false if it
+	 isn't there. */
+static bool readCachedBitmap(struct Entry *const e) {
+	char *const path = cachedPath(e, "");
+	if(path == NULL)
+		return false;
+	size_t size;
+	const unsigned char *const file = mapFile(path, &size);
+	free(path);
+	if(file == NULL)
+		return false;
+
+	const struct CachedBitmap *const header = (const struct CachedBitmap*)file;
+	if(size < sizeof(struct CachedBitmap) || memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != CACHE_VERSION || header->crc != e->crc || header->sourceSize != e->size
+		|| (uint64_t)header->width*header->height*4 != size - sizeof(struct CachedBitmap)
+		|| header->width > INT_MAX || header->height > INT_MAX) {
+		unmapFile(file, size);
+		return false;
+	}
+	e->width = header->width;
+	e->height = header->height;
+	e->data = (unsigned char*)(file + sizeof(struct CachedBitmap)); // never written to, only uploaded
+	e->cached = file;
+	e->cachedSize = size;
+	return true;
+}
+
+/* Saves the decoded bitmap of an entry in the asset cache. It is written to a temporary
+	 file of its own and then renamed, so that nothing ever maps half of one, even if another
+	 player is saving the same bitmap. */
+static void cacheBitmap(const struct Entry *const e) {
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%u.%u.tmp", (unsigned)getpid(), (unsigned)(e - entries)); // unique to the process and the entry, in case another one has the same MD5
+	char *const tmpPath = cachedPath(e, suffix);
+	if(tmpPath == NULL)
+		return;
+	char *const path = cachedPath(e, "");
+
+	struct CachedBitmap header = {.version = CACHE_VERSION, .crc = e->crc, .sourceSize = e->size, .width = e->width, .height = e->height};
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	const size_t size = (size_t)e->width*e->height*4;
+	FILE *const file = fopen(tmpPath, "wb");
+	if(path == NULL || file == NULL || fwrite(&header, sizeof(header), 1, file) != 1 || fwrite(e->data, 1, size, file) != size) {
+		printf("[WARNING]Could not write \"%s\" to the asset cache\n", e->fileName);
+		if(file != NULL) {
+			fclose(file);
+			remove(tmpPath);
+		}
+	}
+	else if(fclose(file) != 0 || rename(tmpPath, path) != 0) {
+		printf("[WARNING]Could not save \"%s\" in the asset cache\n", e->fileName);
+		remove(tmpPath);
+	}
+	free(tmpPath);
+	free(path);
+}
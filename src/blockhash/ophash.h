@@ -0,0 +1,30 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *\
+ * ophash.h                                                            *
+ *                                                                     *
+ * The minimal perfect hash function for block op strings. phtg.c      *
+ * finds the displacements that make it perfect, and the player looks  *
+ * op strings up with the displacements phtg.c wrote into opshash.c.   *
+ * Both have to use the same function, so it is kept here.             *
+ *                                                                     *
+ * Every op string is put in a bucket by its hash with a seed of 0.    *
+ * A bucket's displacement is a seed that hashes all of the op strings *
+ * in it into slots that no other op string is in, or, for a bucket    *
+ * with only one op string, -(slot+1) to give it a slot directly.      *
+\* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#pragma once
+
+/* FNV-1a, starting from a seed */
+static inline uint32 opHash(const uint32 seed, const char *const key, const size_t len) {
+	uint32 h = 2166136261u ^ seed;
+	for(size_t i = 0; i < len; ++i) {
+		h ^= (ubyte)key[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static inline uint32 opSlot(const int16_t *const displacements, const uint32 nOps, const char *const key, const size_t len) {
+	const int16_t d = displacements[opHash(0, key, len) % nOps];
+	return d < 0 ? (uint32)(-d - 1) : opHash(d, key, len) % nOps;
+}
@@ -2,54 +2,102 @@
  * phtg.c                                                              *
  *  Perfect HashTable Generator                                        *
  *                                                                     *
- * Uses cmph and specs.h in this directory to generate minimal perfect *
- * hashing functions for block op strings and block menus, and write   *
- * the resulting hashtables into header files.                         *
+ * Uses specs.h in this directory to generate a minimal perfect        *
+ * hashing function for block op strings (see ophash.h), and write it, *
+ * and the hashtables it indexes, into C files. The player is built    *
+ * with the tables, so it doesn't need to load a hash function or link *
+ * to a hashing library.                                               *
  *                                                                     *
  * NOTE: This module is not part of the final build, it generates      *
  *       parts of the final build.                                     *
 \* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <cmph.h>
 
 #include "specs.h"
 
 #include "../types/primitives.h"
 #include "../types/value.h"
 #include "../types/block.h"
-typedef blockhash hash;
+#include "ophash.h"
 
 #define TOTAL_OPS (sizeof(specs) / sizeof(struct BlockSpec))
-static char *buffer[256];
+static const char *buffer[256];
 static enum BlockType types[256];
 
-int main(void) {
-	// build array of op strings from spec table
-	ufastest i;
-	for(i = 0; i < TOTAL_OPS; ++i)
-		buffer[i] = (char*)specs[i].opString;
+static int16_t displacements[TOTAL_OPS];
+static uint32 buckets[TOTAL_OPS][TOTAL_OPS]; // the op strings in each bucket, by index into specs
+static uint32 bucketSizes[TOTAL_OPS];
+static uint32 order[TOTAL_OPS]; // the buckets, biggest first
+static bool slotTaken[TOTAL_OPS];
 
-	// use array of op strings to generate a minimal perfect hash function for them, and dump it to a file
-	cmph_io_adapter_t *keySource = cmph_io_vector_adapter(buffer, TOTAL_OPS);
-	FILE *mphfStream = fopen("blockops.mphf", "w");
-	if(mphfStream == NULL) {
-		puts("Could not open blockops.mphf!");
-		return 1;
+static int compareBucketSizes(const void *a, const void *b) {
+	return (int)bucketSizes[*(const uint32*)b] - (int)bucketSizes[*(const uint32*)a];
+}
+
+static inline uint32 slotOf(const char *const opString) {
+	return opSlot(displacements, TOTAL_OPS, opString, strlen(opString));
+}
+
+/* Finds the displacement of every bucket. The biggest buckets are done first, while there
+	 are the most free slots. Returns true if it couldn't find one for a bucket. */
+static bool generateHash(void) {
+	uint32 i;
+	for(i = 0; i < TOTAL_OPS; ++i) {
+		const uint32 bucket = opHash(0, specs[i].opString, strlen(specs[i].opString)) % TOTAL_OPS;
+		buckets[bucket][bucketSizes[bucket]++] = i;
+		order[i] = i;
+	}
+	qsort(order, TOTAL_OPS, sizeof(uint32), compareBucketSizes);
+
+	for(i = 0; i < TOTAL_OPS && bucketSizes[order[i]] > 1; ++i) {
+		const uint32 bucket = order[i];
+		uint32 slots[TOTAL_OPS];
+		int16_t d;
+		for(d = 1; d != INT16_MAX; ++d) { // try seeds until every op string in the bucket gets a free slot of its own
+			uint32 j;
+			for(j = 0; j < bucketSizes[bucket]; ++j) {
+				const char *const opString = specs[buckets[bucket][j]].opString;
+				slots[j] = opHash(d, opString, strlen(opString)) % TOTAL_OPS;
+				if(slotTaken[slots[j]])
+					break;
+				uint32 k = 0;
+				while(k < j && slots[k] != slots[j])
+					++k;
+				if(k != j)
+					break;
+			}
+			if(j == bucketSizes[bucket])
+				break;
+		}
+		if(d == INT16_MAX)
+			return true;
+		displacements[bucket] = d;
+		for(uint32 j = 0; j < bucketSizes[bucket]; ++j)
+			slotTaken[slots[j]] = true;
 	}
 
-	cmph_config_t *config = cmph_config_new(keySource);
-	cmph_config_set_algo(config, CMPH_CHD);
-	cmph_config_set_mphf_fd(config, mphfStream);
+	// buckets with one op string are given whatever slots are left
+	uint32 freeSlot = 0;
+	for(; i < TOTAL_OPS && bucketSizes[order[i]] == 1; ++i) {
+		while(slotTaken[freeSlot])
+			++freeSlot;
+		slotTaken[freeSlot] = true;
+		displacements[order[i]] = -(int16_t)freeSlot - 1;
+	}
+	return false;
+}
 
-	cmph_t *mphf = cmph_new(config);
-	cmph_config_destroy(config);
-	cmph_dump(mphf, mphfStream);
-	fclose(mphfStream);
+int main(void) {
+	if(generateHash()) {
+		puts("Could not generate a perfect hash function for the op strings!");
+		return 1;
+	}
 
 	// make table of values for ops hash table, and write key hash mappings to file
-	hash hash;
+	uint32 hash;
 	FILE *mapStream = fopen("map.txt", "w"); // file for writing key and hash pairs to
 	if(mapStream == NULL) {
 		puts("Could not open map.txt!");
@@ -58,15 +106,16 @@ int main(void) {
 
 	fprintf(mapStream, "hash\tkey\n----\t---\n");
 
+	ufastest i;
 	for(i = 0; i < TOTAL_OPS; ++i) {
-		hash = cmph_search(mphf, specs[i].opString, (cmph_uint32)strlen(specs[i].opString));
-		buffer[hash] = (char*)specs[i].name;
+		hash = slotOf(specs[i].opString);
+		buffer[hash] = specs[i].name;
 		types[hash] = specs[i].type;
 		fprintf(mapStream, "0x%x \t%s\n", hash, specs[i].opString);
 	}
 	fclose(mapStream);
 
-	// write tables of values to C header files
+	// write tables of values to C files
 	FILE *opstableStream = fopen("src/blockhash/opstable.c", "w");
 	if(opstableStream == NULL) {
 		puts("Could not open opstable.c!");
@@ -77,6 +126,11 @@ int main(void) {
 		puts("Could not open typestable.c!");
 		return 1;
 	}
+	FILE *opshashStream = fopen("src/blockhash/opshash.c", "w");
+	if(opshashStream == NULL) {
+		puts("Could not open opshash.c!");
+		return 1;
+	}
 
 	fprintf(opstableStream,
 		"#pragma once\n"
@@ -96,10 +150,9 @@ int main(void) {
 		"\tBLOCK_TYPE_E\n"
 		"};\n\n");
 
-	const uint16 totalHashes = cmph_size(mphf);
 	fprintf(opstableStream, "const blockfunc opsTable[] = {\n");
 	fprintf(blocktypeStream, "const enum BlockType blockTypesTable[] = {\n");
-	for(i = 0; i < totalHashes; ++i) {
+	for(i = 0; i < TOTAL_OPS; ++i) {
 		fprintf(opstableStream, "\t%s,\n", buffer[i]);
 		fprintf(blocktypeStream, "\tBLOCK_TYPE_");
 		switch(types[i]) {
@@ -135,7 +188,32 @@ int main(void) {
 	fclose(opstableStream);
 	fclose(blocktypeStream);
 
-	cmph_destroy(mphf);
+	// write the displacements of the hash function, and the op string in each slot, which
+	// lets an op string that isn't in specs.h be told apart from the one it hashes to
+	fprintf(opshashStream,
+		"#pragma once\n"
+		"// GENERATED FILE\n"
+		"// see the README in this directory for details\n\n"
+		"#define N_OPS %u\n"
+		"#define NOOP_HASH %u\n\n"
+		"static const int16_t opDisplacements[] = {\n",
+		(unsigned)TOTAL_OPS, slotOf("noop"));
+	for(i = 0; i < TOTAL_OPS; ++i)
+		fprintf(opshashStream, "\t%d,\n", displacements[i]);
+	fprintf(opshashStream, "};\n\nstatic const char *const opStrings[] = {\n");
+	for(i = 0; i < TOTAL_OPS; ++i)
+		buffer[slotOf(specs[i].opString)] = specs[i].opString;
+	for(i = 0; i < TOTAL_OPS; ++i) {
+		fputs("\t\"", opshashStream);
+		for(const char *c = buffer[i]; *c != '\0'; ++c) {
+			if(*c == '"' || *c == '\\')
+				fputc('\\', opshashStream);
+			fputc(*c, opshashStream);
+		}
+		fputs("\",\n", opshashStream);
+	}
+	fprintf(opshashStream, "};\n");
+	fclose(opshashStream);
 
 	return 0;
 }
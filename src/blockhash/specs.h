@@ -70,8 +70,8 @@ const struct BlockSpec specs[] = {
 	{"show", "bf_noop", s},
 	{"hide", "bf_noop", s},
 
-	{"lookLike:", "bf_noop", s},
-	{"nextCostume", "bf_noop", s},
+	{"lookLike:", "bf_costume_set", s},
+	{"nextCostume", "bf_costume_next", s},
 	{"startScene", "bf_noop", s},
 
 	{"changeGraphicEffect:by:", "bf_gfx_change", s},
@@ -84,7 +84,7 @@ const struct BlockSpec specs[] = {
 	{"comeToFront", "bf_noop", s},
 	{"goBackByLayers:", "bf_noop", s},
 
-	{"costumeIndex", "bf_noop", r},
+	{"costumeIndex", "bf_costume_get", r},
 	{"sceneName", "bf_noop", r},
 	{"scale", "bf_size_get", r},
 
@@ -268,6 +268,17 @@ const struct BlockSpec specs[] = {
 	{"doWhile", "bf_noop", c},
 	{"warpSpeed", "bf_noop", c},
 
+	// Blocks that the loader substitutes for patterns of blocks it can run faster. These
+	// never appear in a project.json.
+	{"appendVar:with:", "bf_variable_append", s},
+	{"concatenateAll", "bf_concatenate_all", r},
+	{"letter:ofVar:", "bf_get_character_of_variable", r},
+	{"stringLengthOfVar:", "bf_get_string_length_of_variable", r},
+	{"readVariableSlot", "bf_get_variable_slot", s},
+	{"setVarSlot:to:", "bf_variable_set_slot", s},
+	{"changeVarSlot:by:", "bf_variable_change_slot", s},
+	{"appendVarSlot:with:", "bf_variable_append_slot", s},
+
 	// choosing not to implement stage motion/scrolling because no projects should be using them
 	//{"scrollRight", "bf_noop", s},
 	//{"scrollUp", "bf_noop", s},
@@ -6,8 +6,10 @@
 #include "ut/uthash.h"
 #include "ut/dynarray.h"
 
+#include "types/value.h"
 #include "types/thread.h"
 #include "types/costume.h"
+#include "types/variables.h"
 #include "types/sprite.h"
 
 #include "graphics.h"
@@ -91,11 +93,13 @@ static inline GLint createShaderProgram(const GLint vertex, const GLint fragment
 	}*/
 
 static inline void drawSprite(SpriteContext *const sprite) {
-	//glBindTexture(sprite->currentCostume->textureHandle);
+	//const struct Costume *const costume = sprite->costumes + sprite->currentCostume;
+	//if(!resourceReady(costume->resource)) return; // don't hold up the frame while the image is read
+	//glBindTexture(GL_TEXTURE_2D, getResource(costume->resource)->data.textureHandle);
 	// if costume is vector
 	//   if needs re-rasterization
 	//     free outdated texture and render the svg to a new texture
-	//glBindVertexArray(sprite->currentCostume->vaoHandle);
+	//glBindVertexArray(costume->vaoHandle);
 	// upload gfx parameters, etc., and run sprite shader
 
 	// if sprite is "saying" or "thinking" something
@@ -0,0 +1,218 @@
+/**
+	JSON Reader
+	  jsonreader.c
+
+	Reads JSON one token at a time, in the order the tokens are in, without building
+	anything up. The project loader makes what it needs straight from each token as it comes
+	to it, so the project.json is only gone through once, and there is no array of tokens
+	that has to be counted and then filled first.
+
+	Separators (commas and colons) are passed over rather than checked, so the keys and
+	values of an object just alternate, and an object or array ends at its closing bracket.
+	Like the rest of loading, this trusts that the project.json is well formed. What it does
+	guard against is running off the end of the input, which is given as JSON_ERROR, so that
+	every loop over tokens comes to an end.
+
+	There is no stack of the objects and arrays that are open, so a reader is small, and it
+	can be copied to look ahead without moving the original.
+
+	Strings are given with their escapes left in, and json_unescape turns them into UTF-8.
+	Most strings have no escapes, or only a few, so it looks for the next backslash 16 bytes
+	at a time with SSE2 when it is available, and copies everything before it at once.
+**/
+
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "types/primitives.h"
+
+#include "jsonreader.h"
+
+static inline bool isSeparator(const char c) {
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == ',' || c == ':';
+}
+
+void jsonReader_init(JsonReader *const r, const char *const json, const size_t len) {
+	r->pos = json;
+	r->end = json+len;
+	r->type = JSON_ERROR;
+	r->start = json;
+	r->len = 0;
+}
+
+/* Moves the reader to the next token, and returns what kind of token it is. */
+enum JsonToken jsonReader_next(JsonReader *const r) {
+	const char *p = r->pos;
+	const char *const end = r->end;
+	while(p != end && isSeparator(*p))
+		++p;
+	r->start = p;
+	if(p == end) {
+		r->len = 0;
+		return r->type = JSON_ERROR;
+	}
+
+	switch(*p++) {
+	case '{': r->type = JSON_OBJECT; break;
+	case '[': r->type = JSON_ARRAY; break;
+	case '}': case ']': r->type = JSON_END; break;
+	case '"':
+		r->start = p;
+		while(p != end && *p != '"') {
+			if(*p == '\\' && ++p == end) // don't let an escaped quote end the string
+				break;
+			++p;
+		}
+		if(p == end) {
+			r->pos = p;
+			r->len = 0;
+			return r->type = JSON_ERROR;
+		}
+		r->len = p - r->start;
+		r->pos = p+1; // past the closing quote
+		return r->type = JSON_STRING;
+	default:
+		while(p != end && !isSeparator(*p) && *p != ']' && *p != '}')
+			++p;
+		r->type = JSON_PRIMITIVE;
+	}
+	r->len = p - r->start;
+	r->pos = p;
+	return r->type;
+}
+
+/* Moves the reader past everything left in the object or array it is in, leaving it on
+	 the closing bracket. Returns JSON_END, or JSON_ERROR if the input ended first. */
+enum JsonToken jsonReader_finish(JsonReader *const r) {
+	uint32 depth = 1;
+	for(;;) {
+		switch(jsonReader_next(r)) {
+		case JSON_ERROR:
+			return JSON_ERROR;
+		case JSON_END:
+			if(--depth == 0)
+				return JSON_END;
+			break;
+		case JSON_OBJECT: case JSON_ARRAY:
+			++depth;
+			break;
+		default:;
+		}
+	}
+}
+
+/* If the reader is on the opening bracket of an object or array, moves it to the closing
+	 bracket, so that the next token is whatever comes after the object or array. */
+void jsonReader_skip(JsonReader *const r) {
+	if(r->type == JSON_OBJECT || r->type == JSON_ARRAY)
+		jsonReader_finish(r);
+}
+
+/* Returns the first backslash from str up to end, or end if there isn't one. */
+static inline const char* findBackslash(const char *str, const char *const end) {
+#ifdef __SSE2__
+	const __m128i backslash = _mm_set1_epi8('\\');
+	for(; end - str >= 16; str += 16) {
+		const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)str), backslash));
+		if(mask != 0)
+			return str + __builtin_ctz(mask);
+	}
+#endif
+	const char *const p = memchr(str, '\\', end - str);
+	return p == NULL ? end : p;
+}
+
+/* Reads the 4 hex digits of a \u escape at str, which must have at least 4 chars left, into
+	 *unit. Returns false if they aren't all hex digits. */
+static inline bool readUtf16Unit(const char *const str, uint32 *const unit) {
+	uint32 u = 0;
+	for(ufastest i = 0; i < 4; ++i) {
+		const char c = str[i];
+		uint32 digit;
+		if(c >= '0' && c <= '9') digit = c - '0';
+		else if(c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+		else if(c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+		else return false;
+		u = u << 4 | digit;
+	}
+	*unit = u;
+	return true;
+}
+
+/* Writes the codepoint c to dst as UTF-8, and returns how many chars it took. */
+static inline size_t encodeUtf8(const uint32 c, char *const dst) {
+	if(c < 0x80) {
+		dst[0] = c;
+		return 1;
+	}
+	if(c < 0x800) {
+		dst[0] = 0xC0 | c >> 6;
+		dst[1] = 0x80 | (c & 0x3F);
+		return 2;
+	}
+	if(c < 0x10000) {
+		dst[0] = 0xE0 | c >> 12;
+		dst[1] = 0x80 | (c >> 6 & 0x3F);
+		dst[2] = 0x80 | (c & 0x3F);
+		return 3;
+	}
+	dst[0] = 0xF0 | c >> 18;
+	dst[1] = 0x80 | (c >> 12 & 0x3F);
+	dst[2] = 0x80 | (c >> 6 & 0x3F);
+	dst[3] = 0x80 | (c & 0x3F);
+	return 4;
+}
+
+#define REPLACEMENT_CHARACTER 0xFFFD // what a surrogate that isn't part of a pair becomes
+
+/* Turns the len chars of a JSON string at str, without its quotes, into UTF-8 at dst, and
+	 returns how many chars were written. No escape is shorter than what it stands for, so
+	 dst needs room for at most len chars. \u escapes are UTF-16, and a surrogate pair of
+	 them is one character. A backslash before anything that isn't an escape is dropped. */
+size_t json_unescape(const char *str, const size_t len, char *const dst) {
+	const char *const end = str+len;
+	char *out = dst;
+	for(;;) {
+		const char *const backslash = findBackslash(str, end);
+		memcpy(out, str, backslash - str);
+		out += backslash - str;
+		if(backslash == end || backslash+1 == end)
+			break;
+		str = backslash+2;
+
+		uint32 c;
+		switch(backslash[1]) {
+		case 'b': *out++ = '\b'; continue;
+		case 'f': *out++ = '\f'; continue;
+		case 'n': *out++ = '\n'; continue;
+		case 'r': *out++ = '\r'; continue;
+		case 't': *out++ = '\t'; continue;
+		case 'u':
+			if(end - str < 4 || !readUtf16Unit(str, &c)) {
+				*out++ = 'u';
+				continue;
+			}
+			str += 4;
+			if(c >= 0xD800 && c <= 0xDBFF) { // a high surrogate, which should be followed by a low one
+				uint32 low;
+				if(end - str >= 6 && str[0] == '\\' && str[1] == 'u' && readUtf16Unit(str+2, &low) && low >= 0xDC00 && low <= 0xDFFF) {
+					c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+					str += 6;
+				}
+				else
+					c = REPLACEMENT_CHARACTER;
+			}
+			else if(c >= 0xDC00 && c <= 0xDFFF)
+				c = REPLACEMENT_CHARACTER;
+			out += encodeUtf8(c, out);
+			continue;
+		default: // \", \\ and \/
+			*out++ = backslash[1];
+		}
+	}
+	return out - dst;
+}
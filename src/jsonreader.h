@@ -0,0 +1,10 @@
+#pragma once
+
+#include "types/jsonreader.h"
+
+extern void jsonReader_init(JsonReader *const r, const char *const json, const size_t len);
+extern enum JsonToken jsonReader_next(JsonReader *const r);
+extern enum JsonToken jsonReader_finish(JsonReader *const r);
+extern void jsonReader_skip(JsonReader *const r);
+
+extern size_t json_unescape(const char *str, const size_t len, char *const dst);
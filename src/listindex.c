@@ -0,0 +1,180 @@
+/**
+	List Index
+	  listindex.c
+
+	A hash table of the items in a list, which lets "list contains" answer without going
+	through every item. Projects often use a list as a set, checking if it contains
+	something before adding it, and without an index that is quadratic.
+
+	The table counts how many items are equal to each key, rather than just recording that
+	there is one, so that deleting one of several equal items from the list leaves the key in
+	the table. Keys compare the way the contains functions in variables.c do: numbers by
+	value (so 0 and -0 are the same key, and NaN is never contained), strings by their bytes,
+	and booleans by value. Values of different types are never equal.
+
+	The table uses open addressing with linear probing, and is kept at most half full. Keys
+	are removed by shifting the following entries of the run back, so there are no
+	tombstones to clean up.
+
+	Deciding when a list should have an index is up to the list (see variables.c).
+**/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "types/primitives.h"
+#include "types/value.h"
+
+#include "listindex.h"
+
+#define MIN_ENTRIES 16
+
+static inline uint64_t mix(uint64_t h) { // the finalizer of splitmix64
+	h ^= h >> 30; h *= UINT64_C(0xbf58476d1ce4e5b9);
+	h ^= h >> 27; h *= UINT64_C(0x94d049bb133111eb);
+	return h ^ (h >> 31);
+}
+
+static uint64_t hashItem(const Value *const item) {
+	switch(item->type) {
+	case FLOATING: {
+		const double f = item->data.floating == 0.0 ? 0.0 : item->data.floating; // -0 is the same key as 0
+		uint64_t bits;
+		memcpy(&bits, &f, sizeof(bits));
+		return mix(bits);
+	}
+	case STRING: { // FNV-1a
+		uint64_t h = UINT64_C(0xcbf29ce484222325);
+		for(const unsigned char *s = (const unsigned char*)item->data.string; *s != '\0'; ++s)
+			h = (h ^ *s) * UINT64_C(0x100000001b3);
+		return mix(h);
+	}
+	default:
+		return mix(item->data.boolean ? 2 : 1);
+	}
+}
+
+static inline bool keyEquals(const Value *const key, const Value *const item) {
+	if(key->type != item->type)
+		return false;
+	switch(item->type) {
+	case FLOATING: return key->data.floating == item->data.floating || (key->data.floating != key->data.floating && item->data.floating != item->data.floating); // NaNs are kept as one key so they can be counted and removed
+	case STRING: return strcmp(key->data.string, item->data.string) == 0;
+	default: return key->data.boolean == item->data.boolean;
+	}
+}
+
+/* returns the entry that has the item as its key, or the empty entry where it would go */
+static struct ListIndexEntry* find(const ListIndex *const index, const Value *const item, const uint64_t hash) {
+	uint32 i = (uint32)hash & index->mask;
+	struct ListIndexEntry *e;
+	while(e = index->entries+i, e->count != 0) {
+		if(e->hash == hash && keyEquals(&e->key, item))
+			return e;
+		i = (i+1) & index->mask;
+	}
+	return e;
+}
+
+static bool grow(ListIndex *const index) {
+	const uint32 oldNEntries = index->mask + 1;
+	struct ListIndexEntry *const old = index->entries;
+	index->entries = calloc(oldNEntries*2, sizeof(struct ListIndexEntry));
+	if(index->entries == NULL) {
+		index->entries = old;
+		return false;
+	}
+	index->mask = oldNEntries*2 - 1;
+	for(uint32 i = 0; i < oldNEntries; ++i) {
+		if(old[i].count != 0) {
+			uint32 j = (uint32)old[i].hash & index->mask;
+			while(index->entries[j].count != 0)
+				j = (j+1) & index->mask;
+			index->entries[j] = old[i];
+		}
+	}
+	free(old);
+	return true;
+}
+
+/* Makes an empty index with room for nItems different keys. Returns true if it could not
+	 be allocated. */
+bool listIndex_init(ListIndex *const index, const uint32 nItems) {
+	uint32 nEntries = MIN_ENTRIES;
+	while(nEntries < nItems*2 && nEntries < UINT32_C(1) << 31)
+		nEntries *= 2;
+	index->entries = calloc(nEntries, sizeof(struct ListIndexEntry));
+	if(index->entries == NULL) {
+		puts("[ERROR]Could not allocate list index.");
+		return true;
+	}
+	index->mask = nEntries - 1;
+	index->nKeys = 0;
+	return false;
+}
+
+void listIndex_done(ListIndex *const index) {
+	for(uint32 i = 0; i <= index->mask; ++i) {
+		if(index->entries[i].count != 0 && index->entries[i].key.type == STRING)
+			free(index->entries[i].key.data.string);
+	}
+	free(index->entries);
+}
+
+/* Counts an item that was put in the list. Returns true if the index could not make room
+	 for it, in which case it no longer matches the list and must be dropped. */
+bool listIndex_add(ListIndex *const index, const Value *const item) {
+	const uint64_t hash = hashItem(item);
+	struct ListIndexEntry *e = find(index, item, hash);
+	if(e->count != 0) {
+		++e->count;
+		return false;
+	}
+	if((index->nKeys+1)*2 > index->mask+1) {
+		if(!grow(index))
+			return true;
+		e = find(index, item, hash);
+	}
+	e->hash = hash;
+	e->key = *item;
+	if(item->type == STRING) {
+		e->key.data.string = strdup(item->data.string);
+		if(e->key.data.string == NULL)
+			return true;
+	}
+	e->count = 1;
+	++index->nKeys;
+	return false;
+}
+
+/* Uncounts an item that was taken out of the list. */
+void listIndex_remove(ListIndex *const index, const Value *const item) {
+	struct ListIndexEntry *e = find(index, item, hashItem(item));
+	if(e->count == 0 || --e->count != 0)
+		return;
+	if(e->key.type == STRING)
+		free(e->key.data.string);
+	--index->nKeys;
+
+	// shift back entries after the removed one that would have been placed at or before it
+	uint32 hole = e - index->entries, i = hole;
+	for(;;) {
+		i = (i+1) & index->mask;
+		struct ListIndexEntry *const next = index->entries+i;
+		if(next->count == 0)
+			break;
+		const uint32 home = (uint32)next->hash & index->mask;
+		if(((i - home) & index->mask) >= ((i - hole) & index->mask)) { // if the hole is between the entry's home and where it is
+			index->entries[hole] = *next;
+			hole = i;
+		}
+	}
+	index->entries[hole].count = 0;
+}
+
+bool listIndex_contains(const ListIndex *const index, const Value *const item) {
+	if(item->type == FLOATING && item->data.floating != item->data.floating) // NaN is never equal to anything
+		return false;
+	return find(index, item, hashItem(item))->count != 0;
+}
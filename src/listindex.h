@@ -0,0 +1,9 @@
+#pragma once
+
+#include "types/listindex.h"
+
+extern bool listIndex_init(ListIndex *const index, const uint32 nItems);
+extern void listIndex_done(ListIndex *const index);
+extern bool listIndex_add(ListIndex *const index, const Value *const item);
+extern void listIndex_remove(ListIndex *const index, const Value *const item);
+extern bool listIndex_contains(const ListIndex *const index, const Value *const item);
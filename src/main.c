@@ -1,4 +1,6 @@
 #define PROJECT_PATH "test.sb2"
+#define PROJECT_IMAGE_PATH PROJECT_PATH ".image" // where the parsed project is kept between runs, or NULL to always parse the SB2
+#define ASSET_CACHE_PATH "asset_cache" // the directory decoded images are kept in between runs, or NULL to always decode them
 
 /**
 	A Scratch project player written in C
@@ -19,7 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <cmph.h>
+#include <SDL2/SDL_opengl.h>
 #include "ut/uthash.h"
 
 #include "types/primitives.h"
@@ -27,13 +29,15 @@
 #include "types/block.h"
 
 #include "project_loader.h"
+#include "zip_loader.h"
 
 #include "runtime.h"
 #include "peripherals.h"
+#include "strpool.h"
 
 int main(void) {
 	initPeripherals(); // load the peripherals, creating a window, first to give the user immediate feedback that the app is starting, and the OGL context needs to exist for loading costumes
-	if(loadProject(PROJECT_PATH)) return EXIT_FAILURE;
+	if(loadProject(PROJECT_PATH, PROJECT_IMAGE_PATH, ASSET_CACHE_PATH)) return EXIT_FAILURE;
 
 	initializeAskPrompt();
 
@@ -42,12 +46,16 @@ int main(void) {
 	puts("running");
 
 	do {
+		uploadResources(); // the images that were read in the background since the last frame
 		if(doRedraw && windowIsShowing)
 			peripheralsOutputTick();
 	} while(peripheralsInputTick() && stepThreads());
 	puts("done.");
+	printf("[INFO]String pool high-water mark: %zu bytes\n", strpool_highWaterMark());
 
 	// TODO: cleanup afterward
+	closeSB2(); // costumes are read from the SB2 while the project runs
+	strpool_free();
 	destroyPeripherals();
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,211 @@
+/**
+	Number Parser
+	  numparse.c
+
+	Converts strings into doubles the way Scratch does. Every string that is turned into a
+	number, from literals in the project.json to strings built while running a project,
+	goes through here, so the common cases need to be cheap.
+
+	The accepted format is what Flash's Number() accepts: optional whitespace around the
+	number, an optional sign, and then either a decimal number with an optional fraction and
+	exponent, a "0x" prefixed hexadecimal integer, or "Infinity". An empty string, or a
+	string of only whitespace, is not a number.
+
+	Decimal numbers are parsed in one pass into a 64 bit mantissa and a power of ten. Whole
+	numbers are converted directly, and when both the mantissa and power of ten are small
+	enough to be represented exactly as doubles, a single multiplication or division gives a
+	correctly rounded result (Clinger's fast path). That covers nearly every number found in
+	a Scratch project. Anything else, like numbers with more than 19 significant digits or
+	huge exponents, is rare enough that it is handed to strtod once the syntax has already
+	been checked.
+
+	Unlike strtod, this does not depend on the current locale.
+**/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <locale.h>
+
+#include "types/primitives.h"
+
+#include "numparse.h"
+
+#define MAX_MANTISSA_DIGITS 19 // the most decimal digits that always fit in a uint64
+#define MAX_EXACT_MANTISSA (UINT64_C(1) << 53) // the largest integer that every integer below it can be exactly represented by a double
+#define MAX_EXACT_POWER 22 // the largest power of ten exactly representable by a double
+
+static const double powersOf10[MAX_EXACT_POWER+1] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isSpace(const char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline bool isDigit(const char c) {
+	return (unsigned char)(c - '0') < 10;
+}
+
+/* returns the value of a hexadecimal digit, or 16 if it isn't one */
+static inline ubyte hexDigit(const char c) {
+	if(isDigit(c)) return c - '0';
+	if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return 16;
+}
+
+static bool parseHex(const char *str, const char *const end, double *const ret) {
+	uint64_t mantissa = 0;
+	for(ubyte nDigits = 0; str != end && nDigits < 16; ++str, ++nDigits) {
+		const ubyte d = hexDigit(*str);
+		if(d == 16)
+			return false;
+		mantissa = mantissa << 4 | d;
+	}
+	double r = (double)mantissa;
+	for(; str != end; ++str) { // only for numbers too long to fit in the mantissa
+		const ubyte d = hexDigit(*str);
+		if(d == 16)
+			return false;
+		r = r*16.0 + d;
+	}
+	*ret = r;
+	return true;
+}
+
+/* Parses a decimal number that strtod will agree is valid, but that is too long for the
+   fast paths. The string is copied, because it is not always null terminated right after
+   the number, and its '.' is swapped for the decimal point of the current locale, which is
+   the one strtod expects. */
+static double slowParse(const char *const str, const size_t len) {
+	char buf[64];
+	char *const copy = len < sizeof(buf) ? buf : malloc(len+1);
+	if(copy == NULL) {
+		puts("[ERROR]Could not allocate buffer for parsing a number.");
+		return 0.0;
+	}
+	memcpy(copy, str, len);
+	copy[len] = '\0';
+	const char *const point = localeconv()->decimal_point;
+	if(point[0] != '.' && point[0] != '\0' && point[1] == '\0') {
+		char *const dot = memchr(copy, '.', len);
+		if(dot != NULL)
+			*dot = point[0];
+	}
+	const double r = strtod(copy, NULL);
+	if(copy != buf)
+		free(copy);
+	return r;
+}
+
+/* Tries to convert the first len characters of str to a double. Returns true and stores
+   the number in ret if the whole string is a number, returns false otherwise. */
+bool strnToFloating(const char *const str, const size_t len, double *const ret) {
+	const char *p = str, *end = str+len;
+
+	// trim whitespace
+	while(p != end && isSpace(*p)) ++p;
+	while(end != p && isSpace(end[-1])) --end;
+	if(p == end)
+		return false;
+
+	const char *const numberStart = p;
+	bool negative = false;
+	if(*p == '-' || *p == '+') {
+		negative = *p == '-';
+		if(++p == end)
+			return false;
+	}
+
+	if(*p == '0' && end-p > 2 && (p[1] == 'x' || p[1] == 'X')) {
+		if(!parseHex(p+2, end, ret))
+			return false;
+		if(negative) *ret = -*ret;
+		return true;
+	}
+
+	if(*p == 'I') {
+		if(end-p != 8 || strncmp(p, "Infinity", 8) != 0)
+			return false;
+		*ret = negative ? -INFINITY : INFINITY;
+		return true;
+	}
+
+	uint64_t mantissa = 0;
+	int32_t exponent = 0;
+	ubyte nMantissaDigits = 0;
+	bool truncated = false, hasDigits = false;
+
+	// whole part
+	for(; p != end && isDigit(*p); ++p) {
+		hasDigits = true;
+		if(nMantissaDigits < MAX_MANTISSA_DIGITS) {
+			mantissa = mantissa*10 + (*p - '0');
+			if(mantissa != 0) ++nMantissaDigits; // don't count leading zeros
+		}
+		else {
+			++exponent;
+			truncated |= *p != '0';
+		}
+	}
+
+	// fractional part
+	if(p != end && *p == '.') {
+		for(++p; p != end && isDigit(*p); ++p) {
+			hasDigits = true;
+			if(nMantissaDigits < MAX_MANTISSA_DIGITS) {
+				mantissa = mantissa*10 + (*p - '0');
+				if(mantissa != 0) ++nMantissaDigits;
+				--exponent;
+			}
+			else
+				truncated |= *p != '0';
+		}
+	}
+	if(!hasDigits)
+		return false;
+
+	// exponent
+	if(p != end && (*p == 'e' || *p == 'E')) {
+		if(++p == end)
+			return false;
+		bool negativeExponent = false;
+		if(*p == '-' || *p == '+') {
+			negativeExponent = *p == '-';
+			if(++p == end)
+				return false;
+		}
+		if(!isDigit(*p))
+			return false;
+		int32_t e = 0;
+		for(; p != end && isDigit(*p); ++p) {
+			if(e < 100000) // anything past this is an overflow or underflow anyway
+				e = e*10 + (*p - '0');
+		}
+		exponent += negativeExponent ? -e : e;
+	}
+	if(p != end) // if there is any junk after the number
+		return false;
+
+	double r;
+	if(mantissa == 0)
+		r = 0.0;
+	else if(!truncated && exponent == 0)
+		r = (double)mantissa; // integer fast path
+	else if(!truncated && mantissa <= MAX_EXACT_MANTISSA && exponent >= -MAX_EXACT_POWER && exponent <= MAX_EXACT_POWER) {
+		// both operands are exact, so the one rounding done by the operation is correct
+		if(exponent < 0)
+			r = (double)mantissa / powersOf10[-exponent];
+		else
+			r = (double)mantissa * powersOf10[exponent];
+	}
+	else {
+		*ret = slowParse(numberStart, end - numberStart);
+		return true;
+	}
+	*ret = negative ? -r : r;
+	return true;
+}
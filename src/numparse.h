@@ -0,0 +1,3 @@
+#pragma once
+
+extern bool strnToFloating(const char *const str, const size_t len, double *const ret);
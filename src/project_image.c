@@ -0,0 +1,601 @@
+/**
+	Project Images
+	  project_image.c
+
+	Parsing a project is the same work every time the same project is loaded, so what it
+	makes can be saved in a project image, and loaded from that instead the next time. A
+	project image holds every script, and everything needed to put the sprites back
+	together: their variables, lists, costumes, threads and procedures. Loading one skips
+	the project.json completely; the SB2 is only used to find the resources in it, which
+	are read when they are used, like they are after parsing.
+
+	The scripts are most of a project, and they never change once they are made, so they
+	are laid out in the image exactly like finalizeScript lays them out in memory. The image
+	is mapped into memory, and the scripts are run right out of the mapping. The pointers in
+	the image are saved as how far into the image what they point to is, and the image keeps
+	a list of where all of them are, so that loading one only has to add where the mapping
+	is to each of them. A Block's func is saved as where it is in opsTable.
+
+	Everything else, like variables and thread collections, changes while the project runs,
+	and is made in the same way parsing makes it, from what the image describes. This file
+	is included by project_loader.c, so that it can use the same functions parsing does.
+
+	An image is made for one build of the player and one SB2. It is ignored, and the SB2 is
+	parsed and a new image saved instead, if the player has been rebuilt or the SB2 has been
+	changed since the image was made. The SB2's size and modification time can stay the same
+	when it is replaced, so the CRC of its project.json, which is in its central directory,
+	has to match too.
+**/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define IMAGE_MAGIC "SB2IMAGE"
+#define IMAGE_VERSION 4
+
+/* The start of an image. Offsets are from the start of the image. */
+struct ImageHeader {
+	char magic[8];
+	uint32 version;
+	uint32 relocations; // offset of an array of the offsets of every pointer in the image
+	uint32 nRelocations;
+	uint32 funcs; // offset of an array of the offsets of every Block func in the image
+	uint32 nFuncs;
+	uint32 project; // offset of the struct ImageProject
+	uint64_t fingerprint; // of the build of the player that made the image
+	uint64_t size; // of the whole image
+	uint64_t sourceSize; // of the SB2 the image was made from
+	int64 sourceTime; // when the SB2 was last modified
+	uint32 sourceCrc; // of the project.json in the SB2
+};
+
+struct ImageThread {
+	const Block *topBlock;
+	const char *msg; // the message, if it is a `when I receive` thread
+	uint32 hatType; // enum HatType
+};
+
+struct ImageProcedure {
+	const Block *script;
+	const char *label;
+	uint32 nParameters;
+};
+
+struct ImageVariable {
+	const char *name;
+	Value value;
+};
+
+struct ImageList {
+	const char *name;
+	const Value *items;
+	uint32 nItems;
+};
+
+struct ImageCostume {
+	const char *name;
+	const char *hash; // the MD5 of the resource, for the asset cache
+	uint32 resource;
+};
+
+struct ImageSprite {
+	const char *name;
+	double xpos, ypos, direction, size;
+	const struct ImageVariable *variables; // in order of slot
+	const struct ImageList *lists;
+	const struct ImageCostume *costumes; // in order
+	const struct ImageThread *threads;
+	const struct ImageProcedure *procedures;
+	uint32 nVariables, nLists, nCostumes, currentCostume, nThreads, nProcedures;
+};
+
+struct ImageProject {
+	const struct ImageSprite *sprites; // the stage comes first
+	uint32 nSprites;
+	double tempo;
+};
+
+/* A script that was parsed, kept until the image is saved. */
+struct ImageScript {
+	const Block *blocks;
+	ubyte *relocations; // the enum Relocation of each Block
+	uint32 nBlocks, nValues;
+	uint32 offset; // where the script is in the image, once it has been written
+};
+
+/* A value that changes whenever the player is built differently, since Blocks in an image
+	 name their funcs by where they are in opsTable, and the structs in an image are laid out
+	 the way the build that made it lays them out. Functions stay the same distance apart
+	 in the same build, wherever it is loaded. */
+static uint64_t imageFingerprint(void) {
+	uint64_t h = 14695981039346656037ULL; // FNV-1a
+#define MIX(x) { h ^= (uint64_t)(x); h *= 1099511628211ULL; }
+	MIX(IMAGE_VERSION);
+	MIX(sizeof(void*));
+	MIX(sizeof(Block));
+	MIX(sizeof(Value));
+	MIX(sizeof(struct ImageSprite));
+	MIX(nOps);
+	for(uint32 i = 0; i < nOps; ++i)
+		MIX(opsTable[i] == NULL ? 0 : (uintptr_t)opsTable[i] - (uintptr_t)&imageFingerprint);
+#undef MIX
+	return h;
+}
+
+/** Saving **/
+
+static void recordScript(const Block *const blocks, const uint32 nBlocks, const uint32 nValues) {
+	struct ImageScript script = {blocks, malloc(nBlocks), nBlocks, nValues, 0};
+	if(nBlocks != 0 && script.relocations == NULL) {
+		puts("[WARNING]Could not keep a script for the project image.");
+		return;
+	}
+	memcpy(script.relocations, scriptRelocations->d, nBlocks);
+	dynarray_push_back(imageScripts, &script);
+}
+
+static void freeImageScripts(void) {
+	struct ImageScript *script = NULL;
+	while((script = dynarray_next(imageScripts, script)) != NULL)
+		free(script->relocations);
+	dynarray_free(imageScripts);
+	imageScripts = NULL;
+}
+
+static dynarray *image; // dynarray of bytes, the image being made
+static dynarray *imageRelocations; // dynarray of uint32s
+static dynarray *imageFuncs; // dynarray of uint32s
+
+#define imageAt(offset) ((void*)(image->d + (offset)))
+
+/* Makes room for size bytes in the image, aligned for anything, and returns where they
+	 are. Anything taken from imageAt is moved by this. */
+static uint32 imageAlloc(const size_t size) {
+	const uint32 offset = (dynarray_len(image) + 7) & ~(uint32)7;
+	dynarray_resize(image, offset + size); // zeroes the new bytes
+	return offset;
+}
+
+/* Points the pointer at offset field to offset target, where 0 is NULL. */
+static void imagePointer(uint32 field, const uint32 target) {
+	*(uintptr_t*)imageAt(field) = target;
+	if(target != 0)
+		dynarray_push_back(imageRelocations, &field);
+}
+
+static uint32 imageString(const char *const str) {
+	if(str == NULL)
+		return 0;
+	const size_t len = strlen(str) + 1;
+	const uint32 offset = imageAlloc(len);
+	memcpy(imageAt(offset), str, len);
+	return offset;
+}
+
+static void imageValue(const uint32 field, const Value *const value) {
+	memcpy(imageAt(field), value, sizeof(Value));
+	if(value->type == STRING)
+		imagePointer(field + offsetof(Value, data.string), imageString(value->data.string));
+}
+
+static void imageFunc(uint32 field, const blockfunc func) {
+	uintptr_t i = 0;
+	while(i < nOps && opsTable[i] != func) // not finding it makes the image fail to load
+		++i;
+	*(uintptr_t*)imageAt(field) = i;
+	dynarray_push_back(imageFuncs, &field);
+}
+
+static void writeScript(struct ImageScript *const script) {
+	const Block *const blocks = script->blocks;
+	const Value *const values = (const Value*)(blocks + script->nBlocks);
+	const size_t lenOfBlocks = script->nBlocks*sizeof(Block);
+	script->offset = imageAlloc(lenOfBlocks + script->nValues*sizeof(Value));
+	const uint32 valuesOffset = script->offset + lenOfBlocks;
+
+	for(uint32 i = 0; i < script->nValues; ++i)
+		imageValue(valuesOffset + i*sizeof(Value), values + i);
+
+#define LINK_OFFSET(link) ((link) == NULL ? 0 : script->offset + (uint32)((link) - blocks)*sizeof(Block))
+	for(uint32 i = 0; i < script->nBlocks; ++i) {
+		const Block *const block = blocks + i;
+		const uint32 field = script->offset + i*sizeof(Block);
+		memcpy(imageAt(field), block, sizeof(Block));
+		if(block->func != NULL)
+			imageFunc(field + offsetof(Block, func), block->func);
+
+		const uint32 p = field + offsetof(Block, p);
+		switch(script->relocations[i]) {
+		case RELOCATE_NONE:
+			break;
+		case RELOCATE_VALUE:
+			imagePointer(p, valuesOffset + (uint32)(block->p.value - values)*sizeof(Value));
+			break;
+		case RELOCATE_NEXT:
+			imagePointer(p, LINK_OFFSET(block->p.next));
+			break;
+		default:;
+			const ubyte nLinks = script->relocations[i] - RELOCATE_SUBSTACKS;
+			const uint32 substacks = imageAlloc(nLinks*sizeof(Block*));
+			for(ubyte j = 0; j < nLinks; ++j)
+				imagePointer(substacks + j*sizeof(Block*), LINK_OFFSET(block->p.substacks[j]));
+			imagePointer(p, substacks);
+		}
+	}
+#undef LINK_OFFSET
+}
+
+static int compareScripts(const void *a, const void *b) {
+	const Block *const x = ((const struct ImageScript*)a)->blocks, *const y = ((const struct ImageScript*)b)->blocks;
+	return (x > y) - (x < y);
+}
+
+/* Where the script starting at blocks was written in the image. */
+static uint32 scriptOffset(const Block *const blocks) {
+	struct ImageScript key = {.blocks = blocks};
+	const struct ImageScript *const script = dynarray_find(imageScripts, &key, compareScripts);
+	return script == NULL ? 0 : script->offset;
+}
+
+/* Works out which hat the thread of s has, from the collections it was put in, since which
+	 hat each thread has isn't kept once the collections are built. */
+static enum HatType threadHatType(const SpriteContext *const s, const ThreadLink *const thread, const char **const msg) {
+	*msg = NULL;
+	for(uint16 i = 0; i < s->whenClonedThreads.nThreads; ++i) {
+		if(s->whenClonedThreads.array[i] == thread)
+			return WHEN_CLONED;
+	}
+	for(uint16 i = 0; i < s->nBroadcastThreadLists; ++i) {
+		const struct ThreadList *const list = s->broadcastThreadLists[i];
+		for(uint16 j = 0; j < list->nThreads; ++j) {
+			if(list->array[j] != thread)
+				continue;
+			struct BroadcastThreads *broadcast, *tmp;
+			HASH_ITER(hh, broadcastsHashTable, broadcast, tmp) {
+				for(const struct ThreadList *l = broadcast->threadList; l != NULL; l = l->next) {
+					if(l == list) {
+						*msg = broadcast->msg;
+						return WHEN_I_RECEIVE;
+					}
+				}
+			}
+		}
+	}
+	return WHEN_GREEN_FLAG_CLICKED;
+}
+
+static void writeSprite(const uint32 offset, const SpriteContext *const s) {
+	struct ImageSprite *i = imageAt(offset);
+	i->xpos = s->xpos;
+	i->ypos = s->ypos;
+	i->direction = s->direction;
+	i->size = s->size;
+	imagePointer(offset + offsetof(struct ImageSprite, name), imageString(s->name));
+
+	// variables
+	const uint32 nVariables = s->variables.symbols->nSymbols;
+	const uint32 variables = imageAlloc(nVariables*sizeof(struct ImageVariable));
+	struct VariableSymbol *symbol, *tmpSymbol;
+	HASH_ITER(hh, s->variables.symbols->names, symbol, tmpSymbol) {
+		const uint32 variable = variables + symbol->slot*sizeof(struct ImageVariable);
+		const Value value = getVariableAt((Variables*)&s->variables, symbol->slot);
+		imagePointer(variable + offsetof(struct ImageVariable, name), imageString(symbol->name));
+		imageValue(variable + offsetof(struct ImageVariable, value), &value);
+	}
+
+	// lists
+	const uint32 nLists = HASH_COUNT(s->lists);
+	const uint32 lists = imageAlloc(nLists*sizeof(struct ImageList));
+	uint32 n = 0;
+	List *list, *tmpList;
+	HASH_ITER(hh, s->lists, list, tmpList) {
+		const uint32 imageList = lists + n++*sizeof(struct ImageList);
+		const uint32 nItems = listLength(list);
+		const uint32 items = imageAlloc(nItems*sizeof(Value));
+		for(uint32 j = 0; j < nItems; ++j) {
+			const Value item = listGet(list, j);
+			imageValue(items + j*sizeof(Value), &item);
+		}
+		((struct ImageList*)imageAt(imageList))->nItems = nItems;
+		imagePointer(imageList + offsetof(struct ImageList, name), imageString(list->name));
+		imagePointer(imageList + offsetof(struct ImageList, items), nItems == 0 ? 0 : items);
+	}
+
+	// costumes
+	const uint32 costumes = imageAlloc(s->nCostumes*sizeof(struct ImageCostume));
+	for(uint16 j = 0; j < s->nCostumes; ++j) {
+		const uint32 costume = costumes + j*sizeof(struct ImageCostume);
+		((struct ImageCostume*)imageAt(costume))->resource = s->costumes[j].resource;
+		imagePointer(costume + offsetof(struct ImageCostume, name), imageString(s->costumes[j].name));
+		imagePointer(costume + offsetof(struct ImageCostume, hash), imageString(getResourceHash(s->costumes[j].resource)));
+	}
+
+	// threads
+	const uint32 threads = imageAlloc(s->nThreads*sizeof(struct ImageThread));
+	for(uint16 j = 0; j < s->nThreads; ++j) {
+		const uint32 thread = threads + j*sizeof(struct ImageThread);
+		const char *msg;
+		((struct ImageThread*)imageAt(thread))->hatType = threadHatType(s, s->threads + j, &msg);
+		imagePointer(thread + offsetof(struct ImageThread, topBlock), scriptOffset(s->threads[j].thread.topBlock));
+		imagePointer(thread + offsetof(struct ImageThread, msg), imageString(msg));
+	}
+
+	// procedures
+	const uint32 nProcedures = HASH_COUNT(s->procedureHashTable);
+	const uint32 procedures = imageAlloc(nProcedures*sizeof(struct ImageProcedure));
+	n = 0;
+	struct ProcedureLink *proc, *tmpProc;
+	HASH_ITER(hh, s->procedureHashTable, proc, tmpProc) {
+		const uint32 procedure = procedures + n++*sizeof(struct ImageProcedure);
+		((struct ImageProcedure*)imageAt(procedure))->nParameters = proc->nParameters;
+		imagePointer(procedure + offsetof(struct ImageProcedure, label), imageString(proc->label));
+		imagePointer(procedure + offsetof(struct ImageProcedure, script), scriptOffset(proc->script));
+	}
+
+	i = imageAt(offset);
+	i->nVariables = nVariables;
+	i->nLists = nLists;
+	i->nCostumes = s->nCostumes;
+	i->currentCostume = s->currentCostume;
+	i->nThreads = s->nThreads;
+	i->nProcedures = nProcedures;
+	imagePointer(offset + offsetof(struct ImageSprite, variables), nVariables == 0 ? 0 : variables);
+	imagePointer(offset + offsetof(struct ImageSprite, lists), nLists == 0 ? 0 : lists);
+	imagePointer(offset + offsetof(struct ImageSprite, costumes), s->nCostumes == 0 ? 0 : costumes);
+	imagePointer(offset + offsetof(struct ImageSprite, threads), s->nThreads == 0 ? 0 : threads);
+	imagePointer(offset + offsetof(struct ImageSprite, procedures), nProcedures == 0 ? 0 : procedures);
+}
+
+/* Appends the uint32s in from to the image, and returns where they are. */
+static uint32 imageOffsets(dynarray *const from) {
+	const uint32 offset = imageAlloc(dynarray_len(from)*sizeof(uint32));
+	memcpy(imageAt(offset), from->d, dynarray_len(from)*sizeof(uint32));
+	return offset;
+}
+
+/* Saves what was parsed into an image at path, for the SB2 described by source. The image
+	 is written to a temporary file of its own and then renamed, so that a player starting at
+	 the same time never sees half of one, even if it is saving the image too. */
+static void saveImage(const char *const path, const struct stat *const source) {
+	dynarray_new(image, sizeof(byte));
+	dynarray_new(imageRelocations, sizeof(uint32));
+	dynarray_new(imageFuncs, sizeof(uint32));
+	imageAlloc(sizeof(struct ImageHeader)); // the header comes first, which also keeps 0 free to mean NULL
+
+	dynarray_sort(imageScripts, compareScripts);
+	struct ImageScript *script = NULL;
+	while((script = dynarray_next(imageScripts, script)) != NULL)
+		writeScript(script);
+
+	const uint32 nSprites = dynarray_len(sprites);
+	const uint32 spritesOffset = imageAlloc(nSprites*sizeof(struct ImageSprite));
+	for(uint32 i = 0; i < nSprites; ++i)
+		writeSprite(spritesOffset + i*sizeof(struct ImageSprite), &(*(struct SpriteLink**)_dynarray_eltptr(sprites, i))->context);
+
+	const uint32 project = imageAlloc(sizeof(struct ImageProject));
+	((struct ImageProject*)imageAt(project))->nSprites = nSprites;
+	((struct ImageProject*)imageAt(project))->tempo = tempo;
+	imagePointer(project + offsetof(struct ImageProject, sprites), spritesOffset);
+
+	const uint32 nRelocations = dynarray_len(imageRelocations), nFuncs = dynarray_len(imageFuncs);
+	const uint32 relocations = imageOffsets(imageRelocations);
+	const uint32 funcs = imageOffsets(imageFuncs);
+
+	struct ImageHeader *const header = imageAt(0);
+	memcpy(header->magic, IMAGE_MAGIC, sizeof(header->magic));
+	header->version = IMAGE_VERSION;
+	header->relocations = relocations;
+	header->nRelocations = nRelocations;
+	header->funcs = funcs;
+	header->nFuncs = nFuncs;
+	header->project = project;
+	header->fingerprint = imageFingerprint();
+	header->size = dynarray_len(image);
+	header->sourceSize = source->st_size;
+	header->sourceTime = source->st_mtime;
+	header->sourceCrc = projectJsonCrc();
+
+	const size_t tmpPathLen = strlen(path) + sizeof(".4294967295.tmp");
+	char *const tmpPath = malloc(tmpPathLen);
+	if(tmpPath != NULL)
+		snprintf(tmpPath, tmpPathLen, "%s.%u.tmp", path, (unsigned)getpid());
+	FILE *const file = tmpPath == NULL ? NULL : fopen(tmpPath, "wb");
+	if(file == NULL || fwrite(image->d, 1, dynarray_len(image), file) != dynarray_len(image)) {
+		printf("[WARNING]Could not write the project image \"%s\"\n", path);
+		if(file != NULL) {
+			fclose(file);
+			remove(tmpPath);
+		}
+	}
+	else if(fclose(file) != 0 || rename(tmpPath, path) != 0) {
+		printf("[WARNING]Could not save the project image \"%s\"\n", path);
+		remove(tmpPath);
+	}
+	free(tmpPath);
+
+	dynarray_free(image);
+	dynarray_free(imageRelocations);
+	dynarray_free(imageFuncs);
+}
+
+/** Loading **/
+
+/* Maps the image at path into memory, where it can be written to without changing the
+	 file. Returns NULL if it couldn't. */
+static byte* mapImage(const char *const path, size_t *const size) {
+#ifdef _WIN32
+	FILE *const file = fopen(path, "rb");
+	if(file == NULL)
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	const long len = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	byte *const data = len > 0 ? malloc(len) : NULL;
+	if(data == NULL || fread(data, 1, len, file) != (size_t)len) {
+		free(data);
+		fclose(file);
+		return NULL;
+	}
+	fclose(file);
+	*size = len;
+	return data;
+#else
+	const int fd = open(path, O_RDONLY);
+	if(fd == -1)
+		return NULL;
+	struct stat st;
+	if(fstat(fd, &st) == -1 || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+	void *const data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED)
+		return NULL;
+	*size = st.st_size;
+	return data;
+#endif
+}
+
+static void unmapImage(byte *const data, const size_t size) {
+#ifdef _WIN32
+	free(data);
+#else
+	munmap(data, size);
+#endif
+}
+
+/* Turns the offsets in the image at base into pointers and funcs. Returns true if any of
+	 them are outside of the image. */
+static bool relocateImage(byte *const base, const struct ImageHeader *const header) {
+	const uint32 *const relocations = (const uint32*)(base + header->relocations);
+	for(uint32 i = 0; i < header->nRelocations; ++i) {
+		if(relocations[i] > header->size - sizeof(uintptr_t))
+			return true;
+		uintptr_t *const pointer = (uintptr_t*)(base + relocations[i]);
+		if(*pointer >= header->size)
+			return true;
+		*pointer += (uintptr_t)base;
+	}
+	const uint32 *const funcs = (const uint32*)(base + header->funcs);
+	for(uint32 i = 0; i < header->nFuncs; ++i) {
+		if(funcs[i] > header->size - sizeof(blockfunc))
+			return true;
+		blockfunc *const func = (blockfunc*)(base + funcs[i]);
+		const uintptr_t op = *(uintptr_t*)func;
+		if(op >= nOps)
+			return true;
+		*func = opsTable[op];
+	}
+	return false;
+}
+
+/* Puts a sprite back together from how it is described in an image, the same way parsing
+	 it would. */
+static void loadImageSprite(const struct ImageSprite *const s) {
+	sprite = newSprite(dynarray_len(sprites) == 0 ? STAGE : SPRITE);
+	sprite->name = s->name;
+	sprite->xpos = s->xpos;
+	sprite->ypos = s->ypos;
+	sprite->direction = s->direction;
+	sprite->size = s->size;
+
+	for(uint32 i = 0; i < s->nVariables; ++i)
+		variable_new(&sprite->variables, s->variables[i].name, strlen(s->variables[i].name), &s->variables[i].value);
+
+	List *lists = NULL;
+	for(uint32 i = 0; i < s->nLists; ++i) {
+		List *const list = list_new(&lists, s->lists[i].name, strlen(s->lists[i].name));
+		if(list == NULL)
+			continue;
+		for(uint32 j = 0; j < s->lists[i].nItems; ++j)
+			listAppend(list, s->lists[i].items + j);
+	}
+	sprite->lists = lists;
+
+	if(s->nCostumes != 0) {
+		Costume *const costumes = malloc(s->nCostumes*sizeof(Costume));
+		for(uint32 i = 0; i < s->nCostumes; ++i) {
+			costumes[i].resource = s->costumes[i].resource;
+			costumes[i].vaoHandle = 0;
+			costumes[i].name = s->costumes[i].name;
+			if(s->costumes[i].hash != NULL)
+				setResourceHash(s->costumes[i].resource, s->costumes[i].hash, strlen(s->costumes[i].hash));
+		}
+		setCostumes(sprite, costumes, s->nCostumes);
+		sprite->currentCostume = s->currentCostume;
+	}
+
+	beginScripts();
+	for(uint32 i = 0; i < s->nThreads; ++i) {
+		const struct ImageThread *const t = s->threads + i;
+		dynarray_extend_back(threads);
+		ThreadLink *const newThread = (ThreadLink*)dynarray_back(threads);
+		threadContext_init(&newThread->thread, t->topBlock);
+		newThread->sprite = sprite;
+
+		const enum HatType hatType = t->hatType;
+		if(hatType == WHEN_I_RECEIVE)
+			addBroadcastMessage((char*)t->msg, strlen(t->msg));
+		else if(hatType == WHEN_CLONED)
+			++nWhenClonedThreads;
+		dynarray_push_back(threadTypes, (void*)&hatType);
+	}
+	for(uint32 i = 0; i < s->nProcedures; ++i) {
+		struct ProcedureLink *const newProc = malloc(sizeof(struct ProcedureLink));
+		newProc->label = (char*)s->procedures[i].label;
+		newProc->nParameters = s->procedures[i].nParameters;
+		newProc->script = (Block*)s->procedures[i].script;
+		HASH_ADD_KEYPTR(hh, procedureHashTable, newProc->label, strlen(newProc->label), newProc);
+	}
+	finishScripts();
+}
+
+/* Loads the project from the image at path, if it was made by this build of the player from
+	 the SB2 described by source. Returns true if it wasn't loaded, and the SB2 has to be
+	 parsed instead. The image stays mapped, since the scripts are in it. */
+static bool loadImage(const char *const path, const struct stat *const source) {
+	size_t size;
+	byte *const base = mapImage(path, &size);
+	if(base == NULL)
+		return true;
+	const struct ImageHeader *const header = (const struct ImageHeader*)base;
+	if(size < sizeof(struct ImageHeader) || memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != IMAGE_VERSION || header->size != size) {
+		printf("[WARNING]\"%s\" is not a project image\n", path);
+		unmapImage(base, size);
+		return true;
+	}
+	if(header->fingerprint != imageFingerprint() || header->sourceSize != (uint64_t)source->st_size || header->sourceTime != (int64)source->st_mtime
+		|| header->sourceCrc != projectJsonCrc()) {
+		puts("[INFO]The project image is out of date");
+		unmapImage(base, size);
+		return true;
+	}
+	if((uint64_t)header->relocations + (uint64_t)header->nRelocations*sizeof(uint32) > size
+		|| (uint64_t)header->funcs + (uint64_t)header->nFuncs*sizeof(uint32) > size
+		|| (uint64_t)header->project + sizeof(struct ImageProject) > size || relocateImage(base, header)) {
+		printf("[WARNING]The project image \"%s\" is corrupt\n", path);
+		unmapImage(base, size);
+		return true;
+	}
+
+	const struct ImageProject *const project = (const struct ImageProject*)(base + header->project);
+	newCollections();
+	for(uint32 i = 0; i < project->nSprites; ++i)
+		loadImageSprite(project->sprites + i);
+	sprite = &(*(struct SpriteLink**)dynarray_front(sprites))->context;
+	tempo = project->tempo;
+	freeCollections();
+	puts("[INFO]Loaded the project image");
+	return false;
+}
@@ -11,9 +11,10 @@
 	This module handles the last two parts. The first part is handled by a separate module:
 	zip_loader.c.
 
-	No resources should be left over from loading. I've even been thinking about shoving all
-	of the modules for loading into a dynamicly loaded library, so that even the code
-	doesn't stick around.
+	Other than the resources, which are read in the background or once they are used while
+	the project runs (see zip_loader.c), nothing should be left over from loading. I've even
+	been thinking about shoving all of the modules for loading into a dynamicly loaded
+	library, so that even the code doesn't stick around.
 
 	The data that makes up a project can be organized into sprites, and the project.json is
 	also organized this way. For this reason, the parser focuses on a sprite at a time and
@@ -26,28 +27,31 @@
 	project.json into sprites and then loads data that was parsed into the runtime and
 	peripherals. The third part's implementation is straight forward.
 
-	Parsing is done by going though the project.json sequentially, and it only operates on
-	one sprite at a time. Data is parsed into either permanent memory locations or into
-	temporary, expandable data structures. Data in temporary data structures is "finalized"
-	or "extracted" when no more data is going to be put into it.
+	Parsing is done by going though the project.json once, from start to end, taking one
+	token at a time from a JSON reader (jsonreader.c), and it only operates on one sprite at a
+	time. Data is parsed into either permanent memory locations or into temporary,
+	expandable data structures. Data in temporary data structures is "finalized" or
+	"extracted" when no more data is going to be put into it.
 
-	There are currently a few exceptions to the way parsing is done, but it works. For
-	instance, when parsing scripts, the space needed is precalculated by breaking the
-	sequential order.
+	Scripts are an example of this. The Blocks and Values of a script are made in scratch
+	space that grows as they are parsed, and is reused for every script. Since the scratch
+	space can move while it grows, pointers within a script are kept as indices until the
+	script is finished, and then the script is moved into an allocation of exactly its size
+	and the indices are turned into pointers.
+
+	What parsing makes can also be saved in a project image, and loaded from it instead of
+	the SB2 the next time the same project is loaded (see project_image.c).
 **/
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <iconv.h>
-#include <errno.h>
 #include <SDL2/SDL_opengl.h>
 
-#include <cmph.h>
 #include "ut/uthash.h"
 
 #include "types/primitives.h"
 
-#include "jsmn/jsmn.h"
 #include "ut/utarray.h"
 #include "ut/dynarray.h"
 
@@ -61,424 +65,573 @@
 
 #include "zip_loader.h"
 
+#include "jsonreader.h"
 #include "value.h"
+#include "numparse.h"
 #include "variables.h"
 #include "runtime.h"
 
-static char *json;
-static jsmntok_t *tokens;
-static unsigned pos;
-
-static struct Resource *resources;
-//static struct Resource *sounds;
-
-static void tokenizeJson(const size_t jsonLength) {
-#define ERROR(s) {puts("[FATAL]"s); return;}
-	jsmn_parser parser;
-
-	jsmn_init(&parser);
-	int nTokens = jsmn_parse(&parser, json, jsonLength, NULL, 0);
-	if(nTokens == JSMN_ERROR_INVAL)
-		ERROR("JSMN_ERROR_INVAL")
-	else if(nTokens == JSMN_ERROR_PART)
-		ERROR("JSMN_ERROR_PART")
-	tokens = malloc(nTokens*sizeof(jsmntok_t));
-
-	jsmn_init(&parser);
-	nTokens = jsmn_parse(&parser, json, jsonLength, tokens, nTokens);
-	if(nTokens == JSMN_ERROR_INVAL)
-		ERROR("JSMN_ERROR_INVAL")
-	else if(nTokens == JSMN_ERROR_PART)
-		ERROR("JSMN_ERROR_PART")
-	else if(nTokens == JSMN_ERROR_NOMEM)
-		ERROR("JSMN_ERROR_NOMEM")
-#undef ERROR
-}
-
-static inline cmph_t* loadBlockHashFunc(void) {
-	FILE *stream = fopen("blockops.mphf", "r");
-	if(stream == NULL) {
-		puts("[FATAL]Could not load block hash function");
-		return NULL;
-	}
-	cmph_t *mph = cmph_load(stream);
-	fclose(stream);
-	return mph;
-}
-
-#define TOKC (tokens[pos])
-#define gjson(tok) (json+(tok).start)
-#define toklen(tok) ((tok).end-(tok).start)
-// calculate length of the current token
-#define tokclen() (toklen(TOKC))
-// check if the current token is equal to the given string.
-#define tokceq(str) (strncmp(str, gjson(TOKC), tokclen()) == 0)
-
-static void skip(void) {
-	uint32 tokensToSkip = 1;
-	do {
-		tokensToSkip += TOKC.size; // add child tokens to tokensToSkip
-		++pos; // skip token
-	} while(--tokensToSkip != 0);
-}
-
-static iconv_t charCd;
+static const char *json;
+
+// check if the token the reader is on is exactly equal to the given string
+#define tokeq(r, str) ((r)->len == sizeof(str)-1 && strncmp(str, (r)->start, (r)->len) == 0)
+
+// convert the token the reader is on, which should be a JSON number, to a double
+static inline double tokToFloating(const JsonReader *const r) {
+	double f;
+	if(!strnToFloating(r->start, r->len, &f))
+		f = 0.0;
+	return f;
+}
+
+// move the reader from a key to its value, and then past the value
+static inline void skipValue(JsonReader *const r) {
+	jsonReader_next(r);
+	jsonReader_skip(r);
+}
+
 static dynarray *charBuffer; // dynarray of chars to be reused for temporarily storing strings
 
 /* Parses the string starting at str of length len into charBuffer. */
 static void parseString(const char *str, const size_t len) {
 	dynarray_clear(charBuffer);
-	dynarray_ensure_size(charBuffer, len);
-	const char *const end = str+len;
-	union {
-		char c;
-		uint32 w;
-	} character;
-
-	char *inbuf, *outbuf;
-	size_t inbytesleft, outbytesleft;
-
-	for(; str != end; ++str) {
-		character.c = *str;
-		if(character.c == '\\') {
-			++str;
-			character.c = *str;
-			switch(character.c) {
-			case 'b': character.c = '\b'; break;
-			case 'f': character.c = '\f'; break;
-			case 'n': character.c = '\n'; break;
-			case 'r': character.c = '\r'; break;
-			case 't': character.c = '\t'; break;
-			case 'u':
-				++str;
-				inbuf = (char*)str+4; // ugly variable reuse
-				character.w = (uint32)strtol(str, &inbuf, 16);
-				if(character.w < 128) { // if the codepoint is within the ASCII range
-					character.c = (char)character.w;
-					str+=3;
-					break;
-				}
-				else {
-					dynarray_reserve(charBuffer, 4);
-
-					inbuf = (char*)&character.w; outbuf = charBuffer->d + charBuffer->i;
-					inbytesleft = 4; outbytesleft = 4;
-					if(iconv(charCd, &inbuf, &inbytesleft, &outbuf, &outbytesleft) == (size_t)-1) {
-						puts("[WARNING]Could not convert unicode codepoint to UTF-8");
-						switch(errno) {
-						case E2BIG: puts("\terrno = E2BIG"); break;
-						case EILSEQ: puts("\terrno = EILSEQ"); break;
-						case EINVAL: puts("\terrno = EINVAL"); break;
-						}
-					}
-
-					charBuffer->i += 4 - outbytesleft;
-					str += 3;
-					continue;
-				}
-			}
-		}
-		dynarray_push_back(charBuffer, &character.c);
-	}
+	dynarray_ensure_size(charBuffer, len+1);
+	charBuffer->i = json_unescape(str, len, charBuffer->d);
 	dynarray_extend_back(charBuffer); // append a terminator to the string
 }
 
-// extract the text pointed to by the current token into dst
-#define tokcext(dst) {																									\
-		parseString(gjson(TOKC), tokclen());																\
+// extract the text of the token the reader is on into dst
+#define tokext(r, dst) {																								\
+		parseString((r)->start, (r)->len);																	\
 		dynarray_extract(charBuffer, (void**)&dst);													\
 	}
 
 static SpriteContext *sprite;
 
-/* Token position should be pointing to the key "variables", just before the array of
-	 variables, and it will be left pointing to the token just after the array. */
-static void parseVariables(void) {
-	++pos; // advance to array
-
-	uint16 propertiesToGo, i = 0, nVariablesToGo = TOKC.size; // number of variable objects to parse
-	Variable *variableBuffer = malloc(nVariablesToGo*sizeof(Variable)); // array of variables, and the first element is also the entry point of the hash table of variables TODO: free
-	Variable *variables = NULL;
+/* The reader should be on the key "variables", just before the array of variables, and it
+	 will be left on the closing bracket of the array. */
+static void parseVariables(JsonReader *const r) {
+	jsonReader_next(r); // advance to array
 
-	char *name;
-	size_t nameLen;
-	Value value;
+	while(jsonReader_next(r) > JSON_END) { // for each variable object
+		char *name = NULL;
+		size_t nameLen;
+		Value value = {.data.floating = 0.0, .type = FLOATING};
 
-	do { // for each variable object
-		++pos; // advance to variable object
-		propertiesToGo = TOKC.size;
-		do { // for each property
-			++pos; // advance to key
-			if(tokceq("name")) {
-				++pos; // advance to value
-				tokcext(name);
+		while(jsonReader_next(r) > JSON_END) { // for each property
+			if(tokeq(r, "name")) {
+				jsonReader_next(r); // advance to value
+				tokext(r, name);
 				nameLen = charBuffer->i-1;
 			}
-			else if(tokceq("value")) {
-				++pos; // advance to value
-				parseString(gjson(TOKC), tokclen());
+			else if(tokeq(r, "value")) {
+				jsonReader_next(r); // advance to value
+				parseString(r->start, r->len);
+				value_free(value);
 				value = strnToValue(charBuffer->d, charBuffer->i-1);
 			}
 			else // isPersistent
-				++pos;
-		} while(--propertiesToGo != 0);
-		variable_init(&variables, variableBuffer+i, name, nameLen, &value);
-		free(name);
+				skipValue(r);
+		}
+		if(name != NULL) {
+			variable_new(&sprite->variables, name, nameLen, &value);
+			free(name);
+		}
 		value_free(value);
-		++i;
-	} while(--nVariablesToGo != 0);
-	++pos; // advance from last property
-	sprite->variables = variables;
+	}
 }
 
-/* Token position should be pointing to the key "lists", just before the array of lists,
-	 and it will be left pointing to the token just after the array. */
-static void parseLists(void) {
-	++pos; // advance to array
-	uint16 i = 0, nListsToGo = TOKC.size; // number of list objects to parse
-	uint32 propertiesToGo;
+/* The reader should be on the array of the items of a list, and will be left on the
+	 closing bracket of it. */
+static void parseListItems(JsonReader *const r, List *const list) {
+	while(jsonReader_next(r) > JSON_END) {
+		parseString(r->start, r->len);
+		Value value = strnToValue(charBuffer->d, charBuffer->i-1);
+		listAppend(list, &value);
+		value_free(value);
+	}
+}
 
-	List *listBuffer = malloc(nListsToGo*sizeof(List)); // TODO: free
+/* The reader should be on the key "lists", just before the array of lists, and it will be
+	 left on the closing bracket of the array. */
+static void parseLists(JsonReader *const r) {
+	jsonReader_next(r); // advance to array
 	List *lists = NULL;
 
-	const jsmntok_t *valueToken;
-	Value value;
+	while(jsonReader_next(r) > JSON_END) { // for each list object
+		List *list = NULL;
+		JsonReader contents = {.type = JSON_ERROR}; // where the items are, if they come before the name
 
-	do { // for each list object
-		++pos; // advance to list object
-		propertiesToGo = TOKC.size;
-		do { // for each property
-			++pos; // advance to key
-			if(tokceq("listName")) {
-				++pos; // advance to value
-				parseString(gjson(TOKC), tokclen());
-			}
-			else if(tokceq("contents")) {
-				valueToken = tokens + ++pos;
-				pos += TOKC.size;
+		while(jsonReader_next(r) > JSON_END) { // for each property
+			if(tokeq(r, "listName")) {
+				jsonReader_next(r); // advance to value
+				parseString(r->start, r->len);
+				list = list_new(&lists, charBuffer->d, charBuffer->i-1);
 			}
-			else {
-				skip();
-				--pos;
+			else if(tokeq(r, "contents")) {
+				jsonReader_next(r); // advance to array of items
+				if(list != NULL)
+					parseListItems(r, list);
+				else { // come back to them once there is a list to put them in
+					contents = *r;
+					jsonReader_skip(r);
+				}
 			}
-		} while(--propertiesToGo != 0);
-		list_init(&lists, listBuffer+i, charBuffer->d, charBuffer->i-1);
-		for(propertiesToGo = valueToken->size; propertiesToGo != 0; --propertiesToGo) {
-			++valueToken;
-			parseString(gjson(*valueToken), toklen(*valueToken));
-			value = strnToValue(charBuffer->d, charBuffer->i-1);
-			listAppend(&listBuffer[i].contents, &value);
-			value_free(value);
+			else
+				skipValue(r);
 		}
-		++i;
-	} while(--nListsToGo != 0);
-	++pos; // advance from last property
+		if(list != NULL && contents.type == JSON_ARRAY)
+			parseListItems(&contents, list);
+	}
 	sprite->lists = lists;
 }
 
-/*static void parseCostumes(void) {
-	++pos; // advance to array of costumes
-	uint32 nCostumesToGo = TOKC.size, i = 0;
-	if(nCostumesToGo == 0) { ++pos; return; }
-	Costume *const costumes = malloc(nCostumesToGo*sizeof(Costume));
-
-	do {
-		++pos;
-		ufastest nPropertiesToGo = TOKC.size;
-		do {
-			++pos; // advance to key
-			if(tokceq("costumeName")) {
-				++pos; // advance to value
-				tokcext(costumes[i].name);
+/* Gives a sprite its costumes, which also makes the array of them a hash table of them by
+	 name. */
+static void setCostumes(SpriteContext *const s, Costume *const costumes, const uint16 nCostumes) {
+	s->costumes = NULL;
+	for(uint16 i = 0; i < nCostumes; ++i)
+		HASH_ADD_KEYPTR(hh, s->costumes, costumes[i].name, strlen(costumes[i].name), costumes+i);
+	s->nCostumes = nCostumes;
+}
+
+/* The reader should be on the key "costumes", just before the array of costumes, and it
+	 will be left on the closing bracket of the array. The images of the costumes are left in
+	 the SB2 until they are used. */
+static void parseCostumes(JsonReader *const r) {
+	jsonReader_next(r); // advance to array
+	dynarray *costumes;
+	dynarray_new(costumes, sizeof(Costume));
+
+	while(jsonReader_next(r) > JSON_END) { // for each costume object
+		Costume costume = {.resource = UINT32_MAX, .vaoHandle = 0, .name = NULL};
+		JsonReader hash = {.type = JSON_ERROR};
+		while(jsonReader_next(r) > JSON_END) { // for each property
+			if(tokeq(r, "costumeName")) {
+				jsonReader_next(r); // advance to value
+				tokext(r, costume.name);
 			}
-			if(tokceq("baseLayerID")) {
-				++pos;
-				uint32 id = strtol(gjson(TOKC), NULL, 10);
-				costumes[i].texturehandle = resources[i].data.textureHandle;
+			else if(tokeq(r, "baseLayerID")) {
+				jsonReader_next(r); // advance to value
+				const double id = tokToFloating(r);
+				if(id >= 0.0 && id < UINT32_MAX)
+					costume.resource = id;
 			}
-			else
-				skip();
-			--pos;
-		} while(--nPropertiesToGo != 0);
-		++i;
-	} while(--nCostumesToGo != 0);
-	++pos;
-	sprite->costumes = costumes;
-	}*/
-
-/* pos should point to first block of script, and will be left pointing after script */
-static void allocateScript(Block **const blocks, Value **const values, uint16 nTokensToGo) {
-	size_t nBlocks = 0, nValues = 0;
-	do {
-		nTokensToGo += TOKC.size;
-		if(TOKC.type == JSMN_ARRAY) { // if it is a block
-			++nBlocks;
-			++pos; --nTokensToGo; nTokensToGo += TOKC.size; // skip past opstring, or to first block of stack input
-			if(TOKC.type == JSMN_ARRAY) { // if it was just a stack input
-				++pos; --nTokensToGo; nTokensToGo += TOKC.size; // skip past opstring, for real this time
+			else if(tokeq(r, "baseLayerMD5")) {
+				jsonReader_next(r); // advance to value
+				hash = *r;
 			}
+			else // bitmapResolution, rotationCenterX, etc.
+				skipValue(r);
 		}
-		else {
-			if(*gjson(TOKC) != 'n') // if it is not just an empty stack input
-				++nValues; // count it as a value
-		}
-		++pos;
-	} while(--nTokensToGo != 0);
-	const size_t lenOfBlocks = (nBlocks + nValues)*sizeof(Block);
-	const size_t len = lenOfBlocks + nValues*sizeof(Value);
-	*blocks = malloc(len); // TODO: free
-	memset(*blocks, 0, len);
-	*values = (Value*)((byte*)*blocks + lenOfBlocks);
+		if(costume.name == NULL)
+			costume.name = "";
+		if(hash.type == JSON_STRING) // the asset cache keeps the image by it
+			setResourceHash(costume.resource, hash.start, hash.len);
+		dynarray_push_back(costumes, &costume);
+	}
+
+	const uint16 nCostumes = dynarray_len(costumes);
+	Costume *finalizedCostumes;
+	dynarray_finalize(costumes, (void**)&finalizedCostumes);
+	setCostumes(sprite, finalizedCostumes, nCostumes);
 }
 
-static cmph_t *blockMphf;
+#include "blockhash/typestable.c"
+#include "blockhash/ophash.h"
+#include "blockhash/opshash.c"
+
+/* Gets the blockhash of an opstring. Opstrings that aren't known, like those of blocks
+	 that aren't implemented, get the hash of "noop". */
+static inline blockhash hash(const char *const key, const size_t keyLen) {
+	const uint32 slot = opSlot(opDisplacements, N_OPS, key, keyLen);
+	if(strncmp(opStrings[slot], key, keyLen) != 0 || opStrings[slot][keyLen] != '\0')
+		return NOOP_HASH;
+	return slot;
+}
 
-static inline uint32 hash(const char *const key, const size_t keyLen, cmph_t *mphf) {
-	return cmph_search(mphf, key, keyLen);
+// opstrings are hashed right out of the JSON, unless they have escapes in them (like "\/")
+static inline blockhash tokhash(const JsonReader *const r) {
+	if(memchr(r->start, '\\', r->len) == NULL)
+		return hash(r->start, r->len);
+	parseString(r->start, r->len);
+	return hash(charBuffer->d, dynarray_len(charBuffer) - 1);
 }
 
-static inline uint32 tokchash(cmph_t *mphf) {
-	parseString(gjson(TOKC), tokclen());
-	return hash(charBuffer->d, dynarray_len(charBuffer) - 1, mphf);
+static blockhash setVarHash, appendVarHash, concatenateHash, joinAllHash,
+	letterOfHash, letterOfVarHash, stringLengthHash, stringLengthOfVarHash,
+	readVariableHash, changeVarHash, readVariableSlotHash, setVarSlotHash,
+	appendVarSlotHash, changeVarSlotHash, getParamHash;
+
+/* The script being parsed. Blocks that point to other parts of the script hold indices
+	 into these instead, since they move as they grow, and each Block has an entry in
+	 scriptRelocations saying how to turn what it holds into a pointer once the script is
+	 finished (see finalizeScript). */
+static dynarray *scriptBlocks; // dynarray of Blocks
+static dynarray *scriptValues; // dynarray of Values
+static dynarray *scriptRelocations; // dynarray of ubytes, one enum Relocation for each Block
+
+enum Relocation {
+	RELOCATE_NONE, // p is not a pointer
+	RELOCATE_VALUE, // p.value is the index of a Value
+	RELOCATE_NEXT, // p.next is a link (see linkTo)
+	RELOCATE_SUBSTACKS // p.substacks holds links, and how many there are is added on to this
+};
+
+// a link to the block at the given index, which keeps NULL free to mean there is nothing to link to
+#define linkTo(index) ((Block*)(uintptr_t)((index)+1))
+#define indexToPointer(index) ((void*)(uintptr_t)(index))
+
+/* A block that names a variable with a constant, which is given the slot of the variable
+	 once every sprite's variables have been parsed (see resolveVariables). */
+struct VariableReference {
+	Block *block;
+	Value *name; // the argument that names the variable
+	blockfunc slotFunc; // what the block is changed to when it is given the slot, or NULL if it takes either
+	SpriteContext *sprite;
+};
+static dynarray *variableReferences;
+
+static inline Block* newBlock(const enum Relocation relocation) {
+	const ubyte r = relocation;
+	dynarray_push_back(scriptRelocations, (void*)&r);
+	dynarray_extend_back(scriptBlocks);
+	return dynarray_back_unchecked(scriptBlocks);
 }
 
-#include "blockhash/typestable.c"
+static void newConstant(const Value *const value, const ubyte level) {
+	const uint32 index = dynarray_len(scriptValues);
+	dynarray_push_back(scriptValues, (void*)value);
+	Block *const block = newBlock(RELOCATE_VALUE);
+	block->func = NULL;
+	block->level = level;
+	block->p.value = indexToPointer(index);
+}
+
+/* Checks if the reader is on a `readVariable` block that names the variable with a
+	 constant. If it is, the reader is moved to the name. */
+static bool isReadVariable(JsonReader *const r) {
+	if(r->type != JSON_ARRAY)
+		return false;
+	JsonReader name = *r;
+	if(jsonReader_next(&name) != JSON_STRING || !tokeq(&name, "readVariable") || jsonReader_next(&name) != JSON_STRING)
+		return false;
+	JsonReader end = name;
+	if(jsonReader_next(&end) != JSON_END)
+		return false;
+	*r = name;
+	return true;
+}
+
+/* Checks if the reader is on the join in a `set [var] to (join (var) [...])` block, where
+	 name is the variable being set. These can be run by appending to the variable in place,
+	 rather than building a whole new string and then copying it into the variable, which is
+	 what makes building up a string one piece at a time quadratic. If it is, the reader is
+	 moved to what is joined onto the variable. */
+static bool isSelfJoin(JsonReader *const r, const char *const name, const size_t nameLen) {
+	if(r->type != JSON_ARRAY)
+		return false;
+	JsonReader join = *r;
+	if(jsonReader_next(&join) != JSON_STRING || !tokeq(&join, "concatenate:with:"))
+		return false;
+	if(jsonReader_next(&join) != JSON_ARRAY || !isReadVariable(&join))
+		return false;
+	if(join.len != nameLen || strncmp(join.start, name, nameLen) != 0)
+		return false;
+	jsonReader_next(&join); // advance past the end of `readVariable`
+	if(jsonReader_next(&join) <= JSON_END) // advance to the second argument of the join
+		return false;
+	*r = join;
+	return true;
+}
+
+/* Checks if the reader is on a substack of a C block, rather than an argument. Substacks
+	 are arrays of blocks, or null if they are empty. */
+static bool isSubstack(const JsonReader *const r) {
+	if(r->type == JSON_PRIMITIVE)
+		return *r->start == 'n';
+	if(r->type != JSON_ARRAY)
+		return false;
+	JsonReader first = *r;
+	return jsonReader_next(&first) != JSON_STRING; // a block starts with its opstring instead
+}
+
+static uint32 lastBlock; // the index of the Block of the last block that parseBlock finished
+static dynarray *procedureParameters; // dynarray of the char*s naming the parameters of the procedure being parsed
+
+static enum BlockType parseBlock(JsonReader *const r, const ubyte level);
+static void parseStack(JsonReader *const r, Block **const first);
+
+/* Parses the argument the reader is on, using recursion if the argument is another block.
+	 The reader is left on the last token of the argument. */
+static void parseArgument(JsonReader *const r, const ubyte level) {
+	Value value;
+	switch(r->type) {
+	case JSON_ARRAY: // argument is a block
+		jsonReader_next(r); // advance to opstring
+		parseBlock(r, level+1);
+		return;
+	case JSON_STRING: // argument is a string
+		value.type = STRING;
+		tokext(r, value.data.string);
+		break;
+	default: // argument is a primitive
+		value = strnToValue(r->start, r->len); // assume characters don't need special parsing
+		jsonReader_skip(r);
+	}
+	newConstant(&value, level);
+}
+
+/* Nested joins are flattened into one block that takes all of their arguments, so that the
+	 result is built in one allocation rather than every level making a new string that the
+	 level above copies again. The reader should be on the opstring of a join. Parses the
+	 arguments of it, and of any joins nested in it, in order as if they were the arguments
+	 of one block, and returns how many there were. *nested is set if there were any nested
+	 joins. The reader is left on the closing bracket of the join. */
+static uint16 parseJoinArguments(JsonReader *const r, const ubyte level, bool *const nested) {
+	uint16 nArgs = 0;
+	while(jsonReader_next(r) > JSON_END) {
+		if(r->type == JSON_ARRAY) {
+			jsonReader_next(r); // advance to opstring
+			if(tokeq(r, "concatenate:with:")) {
+				*nested = true;
+				nArgs += parseJoinArguments(r, level, nested);
+				continue;
+			}
+			parseBlock(r, level+1);
+		}
+		else
+			parseArgument(r, level);
+		++nArgs;
+	}
+	return nArgs;
+}
+
+/* Parses a substack of a C block, which the reader should be on, into *first. */
+static void parseSubstack(JsonReader *const r, Block **const first) {
+	if(r->type == JSON_ARRAY)
+		parseStack(r, first);
+	else // it is empty
+		*first = NULL;
+}
+
+/* Parses a block and its arguments, using recursion when one of the arguments is another
+	 block. The reader should be on the opstring of the block, and is left on the closing
+	 bracket of it. The Block for the block itself comes after the Blocks of its arguments,
+	 and before the Blocks of its substacks. */
+static enum BlockType parseBlock(JsonReader *const r, const ubyte level) {
+	blockhash hash = tokhash(r);
+
+	if(hash == getParamHash) { // if it is a procedure parameter
+		jsonReader_next(r); // advance to argument (param name)
+		parseString(r->start, r->len);
+		uint32 i;
+		for(i = 0; i < dynarray_len(procedureParameters); ++i) {
+			if(strcmp(charBuffer->d, *(char**)_dynarray_eltptr(procedureParameters, i)) == 0)
+				break;
+		}
+		Value value = {.type = FLOATING};
+		if(i == dynarray_len(procedureParameters)) {
+			puts("[WARNING]Could not match procedure parameter to one of the defined parameters.");
+			value.data.integer = 0;
+		}
+		else
+			value.data.integer = i;
+		newConstant(&value, level);
+		Block *const block = newBlock(RELOCATE_NONE);
+		block->func = opsTable[getParamHash];
+		block->level = level - 1;
+		block->p.next = NULL;
+		jsonReader_finish(r);
+		return BLOCK_TYPE_R;
+	}
+
+	if(hash == concatenateHash) {
+		bool nested = false;
+		const uint16 nArgs = parseJoinArguments(r, level, &nested);
+		Block *const block = newBlock(RELOCATE_NONE);
+		block->level = level - 1;
+		if(nested) {
+			block->func = opsTable[joinAllHash];
+			block->p.nArgs = nArgs;
+		}
+		else {
+			block->func = opsTable[concatenateHash];
+			block->p.next = NULL;
+		}
+		return BLOCK_TYPE_R;
+	}
 
-static char **procedureParameters; // TODO: switch this to a dynarray
-static uint16 nParameters;
-
-/* Parses arguments to a block, using recursion when one of the arguments is another
-	 block. pos should point to the first block, and is left pointing at the last token
-	 parsed. *blocks is left pointing at the last item made. *values is left pointing after
-	 the last item made. */
-static enum BlockType parseBlock(Block **const blocks, Value **const values, const ubyte level) {
-	Block *block = *blocks;
-	Value *value = *values;
-
-	uint16 argsToGo = TOKC.size;
-	++pos; // advance to opstring
-	const blockhash hash = tokchash(blockMphf);
-	const blockfunc func = opsTable[hash];
 	const enum BlockType type = blockTypesTable[hash];
+	ufastest nSubstacks = 0, nLinks = 0; // substacks, and links to other stacks including the one following the block
 	switch(type) {
-	case BLOCK_TYPE_C: case BLOCK_TYPE_CF:
-		--argsToGo; break;
-	case BLOCK_TYPE_E:
-		argsToGo -= 2; break;
+	case BLOCK_TYPE_C: nSubstacks = 1; nLinks = 2; break;
+	case BLOCK_TYPE_CF: nSubstacks = 1; nLinks = 1; break;
+	case BLOCK_TYPE_E: nSubstacks = 2; nLinks = 3; break;
 	default:;
 	}
 
-	while(--argsToGo != 0) {
-		++pos; // advance to next argument
-		if(TOKC.type == JSMN_ARRAY) { // if argument is a block
-			++pos; // advance to opstring
-			if(!tokceq("getParam")) {
-				--pos;
-				parseBlock(&block, &value, level+1);
-			}
-			else { // if it is a procedure parameter
-				++pos; // advance to argument (param name)
-				parseString(gjson(TOKC), tokclen());
-				uint16 i;
-				for(i = 0; i < nParameters; ++i) {
-					if(strcmp(charBuffer->d, procedureParameters[i]) == 0)
-						break;
-				}
-				if(i == nParameters) {
-					puts("[WARNING]Could not match procedure parameter to one of the defined parameters.");
-					value->data.integer = 0;
-				}
-				else
-					value->data.integer = i;
-				value->type = FLOATING;
-				block->func = NULL;
-				block->p.value = value;
-				block->level = level + 1;
-				++value;
-				++block;
-				block->func = opsTable[cmph_search(blockMphf, "getParam", 8)];
-				block->level = level;
-				++pos; // advance to second argument
-			}
+	const char *firstArg = NULL; // the text of the first argument, if it is a string
+	size_t firstArgLen = 0;
+	ufastest readVariableArg = UINT_FAST8_MAX; // the argument that is reading a variable that this block is being replaced to read itself
+	uint32 variableName = UINT32_MAX; // the index of the argument that names a variable, which can be replaced by its slot
+
+	enum JsonToken token;
+	for(ufastest argN = 0; (token = jsonReader_next(r)) > JSON_END; ++argN) {
+		if(nSubstacks != 0 && isSubstack(r))
+			break;
+
+		bool inside = false; // whether the reader was moved into the argument, to the part of it that is used
+		if(argN == 1 && hash == setVarHash && firstArg != NULL && isSelfJoin(r, firstArg, firstArgLen)) {
+			hash = appendVarHash; // the argument is now just what is joined onto the variable
+			inside = true;
 		}
-		else {
-			if(TOKC.type == JSMN_STRING) { // argument is a string
-				value->type = STRING;
-				tokcext(value->data.string);
-			}
-			else { // else argument is a primitive
-				*value = strnToValue(gjson(TOKC), tokclen()); // assume characters don't need special parsing
+		// the string blocks keep an index of the characters in a variable, rather than going
+		// through the whole string each time, if they know they are using a variable
+		else if(argN == 1 && hash == letterOfHash && isReadVariable(r)) {
+			hash = letterOfVarHash;
+			readVariableArg = 1;
+			inside = true;
+		}
+		else if(argN == 0 && hash == stringLengthHash && isReadVariable(r)) {
+			hash = stringLengthOfVarHash;
+			readVariableArg = 0;
+			inside = true;
+		}
+
+		if(r->type == JSON_STRING) {
+			if(argN == readVariableArg || (argN == 0 && (hash == readVariableHash || hash == setVarHash || hash == appendVarHash || hash == changeVarHash)))
+				variableName = dynarray_len(scriptValues);
+			if(argN == 0) {
+				firstArg = r->start;
+				firstArgLen = r->len;
 			}
-			block->func = NULL;
-			block->p.value = value;
-			block->level = level;
-			++value;
 		}
-		++block;
+		parseArgument(r, level);
+		if(inside)
+			jsonReader_finish(r); // advance past the rest of the argument
+	}
+
+	enum Relocation relocation;
+	switch(type) {
+	case BLOCK_TYPE_S: case BLOCK_TYPE_F: relocation = RELOCATE_NEXT; break;
+	case BLOCK_TYPE_C: case BLOCK_TYPE_CF: case BLOCK_TYPE_E: relocation = RELOCATE_SUBSTACKS + nLinks; break;
+	default: relocation = RELOCATE_NONE;
 	}
-	block->func = func;
+	const uint32 index = dynarray_len(scriptBlocks);
+	Block *const block = newBlock(relocation);
+	block->func = opsTable[hash];
 	block->level = level - 1;
 	block->p.next = NULL;
 
-	*blocks = block;
-	*values = value;
+	if(variableName != UINT32_MAX) {
+		blockhash slotHash = 0;
+		if(hash == readVariableHash) slotHash = readVariableSlotHash;
+		else if(hash == setVarHash) slotHash = setVarSlotHash;
+		else if(hash == appendVarHash) slotHash = appendVarSlotHash;
+		else if(hash == changeVarHash) slotHash = changeVarSlotHash;
+		struct VariableReference ref = {indexToPointer(index), indexToPointer(variableName), slotHash == 0 ? NULL : opsTable[slotHash], sprite};
+		dynarray_push_back(variableReferences, &ref);
+	}
+
+	if(nLinks != 0) {
+		Block **const substacks = calloc(nLinks, sizeof(Block*));
+		block->p.substacks = substacks; // block can move while the substacks are parsed, but this can't
+		for(ufastest i = 0; token > JSON_END; token = jsonReader_next(r)) {
+			if(i < nSubstacks)
+				parseSubstack(r, substacks + i++);
+			else
+				jsonReader_skip(r);
+		}
+	}
+	lastBlock = index;
 	return type;
 }
 
-/* pos should be pointing to first block of the stack, and will be left pointing after the
-	 last token parsed. *blocks and *values will be left pointing after the last items made. */
-static void parseStack(Block **const blocks, Value **const values, uint16 nStackBlocksToGo, Block **link) {
-	Block *block = *blocks;
-	if(nStackBlocksToGo != 0) {
-		do {
-			if(link != NULL)
-				*link = block;
-
-			switch(parseBlock(&block, values, 1)) {
+/* Makes the stack block at index `from` go on to the block at index `to`. */
+static void linkBlocks(const uint32 from, const uint32 to) {
+	Block *const block = _dynarray_eltptr(scriptBlocks, from);
+	const ubyte relocation = *(ubyte*)_dynarray_eltptr(scriptRelocations, from);
+	if(relocation == RELOCATE_NEXT)
+		block->p.next = linkTo(to);
+	else if(relocation > RELOCATE_SUBSTACKS + 1) // C and E blocks link to what follows them after their substacks
+		block->p.substacks[relocation - RELOCATE_SUBSTACKS - 1] = linkTo(to);
+}
 
-			case BLOCK_TYPE_S: case BLOCK_TYPE_F: // 1 substack: 1 following (normal stack block)
-				link = &(block->p.next);
-				++block;
-				++pos;
-				break;
+/* Parses a stack of blocks. The reader should be on the opening bracket of the stack, or
+	 on whatever is just before its first block, and is left on the closing bracket of it. *first is set to a link
+	 to the first block, or NULL if the stack is empty. */
+static void parseStack(JsonReader *const r, Block **const first) {
+	*first = NULL;
+	uint32 previous = UINT32_MAX; // the index of the last stack block
+	while(jsonReader_next(r) > JSON_END) {
+		if(r->type != JSON_ARRAY) {
+			puts("[ERROR]Encountered something other than a block in a stack.");
+			jsonReader_skip(r);
+			continue;
+		}
+		const uint32 start = dynarray_len(scriptBlocks);
+		jsonReader_next(r); // advance to opstring
+		switch(parseBlock(r, 1)) {
+		case BLOCK_TYPE_S: case BLOCK_TYPE_F: case BLOCK_TYPE_C: case BLOCK_TYPE_CF: case BLOCK_TYPE_E:
+			if(previous == UINT32_MAX)
+				*first = linkTo(start);
+			else
+				linkBlocks(previous, start);
+			previous = lastBlock;
+			break;
+		default:
+			puts("[ERROR]Encountered a non-stacking block where a stacking block was expected.");
+		}
+	}
+}
 
-			case BLOCK_TYPE_C: // 2 substacks: 1 inner and 1 following
-				block->p.substacks = malloc(2*sizeof(Block*));
-				link = block->p.substacks+1;
-				++block;
-				pos += 2; // advance to first block of substack
-				parseStack(&block, values, tokens[pos-1].size, (block-1)->p.substacks+0);
-				break;
+static dynarray *imageScripts; // dynarray of struct ImageScripts, if a project image is being made (see project_image.c)
+static void recordScript(const Block *const blocks, const uint32 nBlocks, const uint32 nValues);
+
+/* Moves the script in scratch space into its own allocation, turns the indices it holds
+	 into pointers, and returns it. References to variables in the script start from
+	 firstReference. */
+static Block* finalizeScript(const uint32 firstReference) {
+	const uint32 nBlocks = dynarray_len(scriptBlocks), nValues = dynarray_len(scriptValues);
+	const size_t lenOfBlocks = nBlocks*sizeof(Block);
+	Block *const blocks = malloc(lenOfBlocks + nValues*sizeof(Value)); // TODO: free
+	Value *const values = (Value*)((byte*)blocks + lenOfBlocks);
+	memcpy(blocks, scriptBlocks->d, lenOfBlocks);
+	memcpy(values, scriptValues->d, nValues*sizeof(Value));
+
+#define RELOCATE_LINK(link) ((link) == NULL ? NULL : blocks + ((uintptr_t)(link) - 1))
+	const ubyte *const relocations = (const ubyte*)scriptRelocations->d;
+	for(uint32 i = 0; i < nBlocks; ++i) {
+		switch(relocations[i]) {
+		case RELOCATE_NONE:
+			break;
+		case RELOCATE_VALUE:
+			blocks[i].p.value = values + (uintptr_t)blocks[i].p.value;
+			break;
+		case RELOCATE_NEXT:
+			blocks[i].p.next = RELOCATE_LINK(blocks[i].p.next);
+			break;
+		default:
+			for(ubyte j = relocations[i] - RELOCATE_SUBSTACKS; j-- != 0;)
+				blocks[i].p.substacks[j] = RELOCATE_LINK(blocks[i].p.substacks[j]);
+		}
+	}
+#undef RELOCATE_LINK
 
-			case BLOCK_TYPE_CF: // 1 substack: 1 inner and no following
-				block->p.substacks = malloc(1*sizeof(Block*));
-				link = NULL;
-				++block;
-				pos += 2;
-				parseStack(&block, values, tokens[pos-1].size, (block-1)->p.substacks+0);
-				break;
+	struct VariableReference *ref = dynarray_eltptr(variableReferences, firstReference);
+	for(; ref != NULL; ref = dynarray_next(variableReferences, ref)) {
+		ref->block = blocks + (uintptr_t)ref->block;
+		ref->name = values + (uintptr_t)ref->name;
+	}
 
-				Block **substacks;
-			case BLOCK_TYPE_E: // 3 substacks: 2 inner and 1 following
-				substacks = malloc(3*sizeof(Block*));
-				block->p.substacks = substacks;
-				link = substacks+2;
-				++block;
-				pos += 2;
-				parseStack(&block, values, tokens[pos-1].size, substacks+0);
-				++pos;
-				parseStack(&block, values, tokens[pos-1].size, substacks+1);
-				break;
+	if(imageScripts != NULL)
+		recordScript(blocks, nBlocks, nValues);
 
-			default:
-				puts("[ERROR]Encountered a non-stacking block where a stacking block was expected.");
-				pos -= 2;
-				skip();
-			}
-		} while(--nStackBlocksToGo != 0);
-	}
-	*link = NULL;
-	*blocks = block;
+	dynarray_clear(scriptBlocks);
+	dynarray_clear(scriptValues);
+	dynarray_clear(scriptRelocations);
+	return blocks;
 }
 
 // collections of references to threads to load into the runtime
@@ -501,13 +654,9 @@ static dynarray *broadcastThreadLists; // a pointer to each ThreadList for broad
 
 static struct ProcedureLink *procedureHashTable;
 
-static inline void addBroadcast(void) {
-	// get message
-	++pos; // advance to message
-	char *msg;
-	tokcext(msg);
-	--pos; // return to opstring
-
+/* Adds a `when I receive` thread for the message msg, of length msgLen, to the thread
+	 collections. msg is kept if the message is new. */
+static void addBroadcastMessage(char *const msg, const size_t msgLen) {
 	// create or get global entry in broadcastsHashTable
 	struct BroadcastThreads *newBroadcast;
 	HASH_FIND_STR(broadcastsHashTable, msg, newBroadcast);
@@ -515,7 +664,7 @@ static inline void addBroadcast(void) {
 		newBroadcast = malloc(sizeof(struct BroadcastThreads));
 		newBroadcast->msg = msg;
 		newBroadcast->nullifyOnRestart = NULL;
-		HASH_ADD_KEYPTR(hh, broadcastsHashTable, newBroadcast->msg, charBuffer->i-1, newBroadcast);
+		HASH_ADD_KEYPTR(hh, broadcastsHashTable, newBroadcast->msg, msgLen, newBroadcast);
 		newBroadcast->threadList = NULL;
 	}
 
@@ -542,26 +691,31 @@ static inline void addBroadcast(void) {
 	dynarray_push_back(broadcastTypes, &newBroadcast->threadList);
 }
 
-static inline Block** addProcedure(void) {
-	struct ProcedureLink *newProc = malloc(sizeof(struct ProcedureLink));
-
-	++pos; // advance to procedure label
-	tokcext(newProc->label);
+/* The reader should be on the opstring of a `when I receive` hat, and is left on the
+	 message. */
+static inline void addBroadcast(JsonReader *const r) {
+	jsonReader_next(r); // advance to message
+	char *msg;
+	tokext(r, msg);
+	addBroadcastMessage(msg, charBuffer->i-1);
+}
 
-	++pos; // advance to array of parameter declarations
-	nParameters = TOKC.size;
-	newProc->nParameters = nParameters;
+/* The reader should be on the opstring of a procedure definition, and is left on the
+	 closing bracket of the array of parameter names. */
+static inline Block** addProcedure(JsonReader *const r) {
+	struct ProcedureLink *newProc = malloc(sizeof(struct ProcedureLink));
 
+	jsonReader_next(r); // advance to procedure label
+	tokext(r, newProc->label);
 	HASH_ADD_KEYPTR(hh, procedureHashTable, newProc->label, charBuffer->i-1, newProc);
 
-	if(nParameters != 0) { // store names of parameter names, in order
-		procedureParameters = malloc(nParameters*sizeof(char*));
-		for(uint16 i = 0; i < nParameters; ++i) {
-			++pos;
-			tokcext(procedureParameters[i]);
-		}
+	jsonReader_next(r); // advance to array of parameter declarations
+	while(jsonReader_next(r) > JSON_END) { // store names of parameter names, in order
+		char *name;
+		tokext(r, name);
+		dynarray_push_back(procedureParameters, &name);
 	}
-	pos -= nParameters + 2; // return to opstring of procedure
+	newProc->nParameters = dynarray_len(procedureParameters);
 
 	return &newProc->script;
 }
@@ -607,33 +761,47 @@ static inline void buildThreadCollections(void) {
 	dynarray_extract(broadcastThreadLists, (void**)&sprite->broadcastThreadLists);
 }
 
-static void parseScripts(void) {
-	// cleanup after last run
+/* Gets ready to collect the threads and procedures of a sprite. */
+static void beginScripts(void) {
 	dynarray_clear(threads);
 	dynarray_clear(threadTypes);
 	nWhenClonedThreads = 0;
 	dynarray_clear(broadcastTypes);
 	dynarray_clear(broadcastThreadLists);
 	procedureHashTable = NULL;
+}
 
-	// begin parsing
-	++pos; // advance to array of scripts
-	uint16 nScriptsToGo = TOKC.size;
-	++pos; // advance to first script ([xpos, ypos, [blocks...]])
-	do { // for each script
-		pos += 3; // advance past script position to script (array of blocks)
-		const uint16 nStackBlocks = TOKC.size - 1;
-		if(nStackBlocks == 0) { // if it is a lone block
-			skip();
+/* Loads the threads and procedures that were collected into the sprite. */
+static void finishScripts(void) {
+	sprite->nThreads = dynarray_len(threads);
+	dynarray_extract(threads, (void**)&sprite->threads);
+	sprite->procedureHashTable = procedureHashTable;
+	buildThreadCollections();
+}
+
+static void parseScripts(JsonReader *const r) {
+	beginScripts();
+
+	jsonReader_next(r); // advance to array of scripts
+	while(jsonReader_next(r) > JSON_END) { // for each script ([xpos, ypos, [blocks...]])
+		jsonReader_next(r); jsonReader_next(r); // advance past script position
+		jsonReader_next(r); // advance to script (array of blocks)
+		JsonReader afterHat = *r;
+		jsonReader_next(&afterHat);
+		jsonReader_skip(&afterHat);
+		if(jsonReader_next(&afterHat) <= JSON_END) { // if it is a lone block
+			jsonReader_finish(r); // advance past the array of blocks
+			jsonReader_finish(r); // advance past the script
 			continue;
 		}
 
 		Block **scriptPointer;
-		pos += 2; // advance to hat block's opstring
+		jsonReader_next(r); // advance to hat block
+		jsonReader_next(r); // advance to hat block's opstring
 		bool isProcedure = false;
-		if(tokceq("procDef")) {
+		if(tokeq(r, "procDef")) {
 			isProcedure = true;
-			scriptPointer = addProcedure();
+			scriptPointer = addProcedure(r);
 		}
 		else { // TODO: use a hash table rather than repeatedly comparing strings
 			dynarray_extend_back(threads);
@@ -644,91 +812,87 @@ static void parseScripts(void) {
 			scriptPointer = (Block**)&newThread->thread.topBlock;
 
 			enum HatType hatType;
-			if(tokceq("whenGreenFlag")) {
+			if(tokeq(r, "whenGreenFlag")) {
 				hatType = WHEN_GREEN_FLAG_CLICKED;
 			}
-			else if(tokceq("whenIReceive")) {
+			else if(tokeq(r, "whenIReceive")) {
 				hatType = WHEN_I_RECEIVE;
-				addBroadcast();
+				addBroadcast(r);
 			}
-			else if(tokceq("whenCloned")) {
+			else if(tokeq(r, "whenCloned")) {
 				++nWhenClonedThreads;
 				hatType = WHEN_CLONED;
 			}
 			else { // it is not a hat
 				threadContext_done(&newThread->thread);
 				dynarray_pop_back(threads);
-				pos -= 5; // go back to script ([xpos, ypos, [blocks...]])
-				skip(); // skip the script
+				jsonReader_finish(r); // advance past the block
+				jsonReader_finish(r); // advance past the array of blocks
+				jsonReader_finish(r); // advance past the script
 				continue;
 			}
 			dynarray_push_back(threadTypes, &hatType);
 		}
-		--pos; // go back to hat block (array)
-		skip(); // advance to past hat block
-
-		// allocate enough space for all the Blocks and Values that will make it up
-		Value *valueBuffer;
-		const unsigned scriptPos = pos;
-		allocateScript(scriptPointer, &valueBuffer, nStackBlocks);
+		jsonReader_finish(r); // advance past hat block
 
-		// parse it into Blocks and Values
-		pos = scriptPos; // return to the top of the script
-		Block *blocks = *scriptPointer; Value *values = valueBuffer;
-		parseStack(&blocks, &values, nStackBlocks, NULL);
+		// parse the rest of the script into Blocks and Values
+		const uint32 firstReference = dynarray_len(variableReferences);
+		Block *first;
+		parseStack(r, &first);
+		*scriptPointer = finalizeScript(firstReference);
+		jsonReader_finish(r); // advance past the script
 
 		// cleanup
 		if(isProcedure) {
-			if(nParameters != 0) {
-				while(nParameters != 0)
-					free(procedureParameters[--nParameters]);
-				free(procedureParameters);
-			}
+			char **name = NULL;
+			while((name = dynarray_next(procedureParameters, name)) != NULL)
+				free(*name);
+			dynarray_clear(procedureParameters);
 		}
-	} while(--nScriptsToGo != 0);
-
-	// load into sprite
-	sprite->nThreads = dynarray_len(threads);
-	dynarray_extract(threads, (void**)&sprite->threads);
-	sprite->procedureHashTable = procedureHashTable;
-	buildThreadCollections();
+	}
+	finishScripts();
 }
 
-static bool attemptToParseSpriteProperty(void) {
-	if(tokceq("variables")) {
+/* The reader should be on a key of a sprite. If it is a property of the sprite, it is
+	 parsed and the reader is left on the last token of its value. Returns false if it is not
+	 a property of the sprite. */
+static bool attemptToParseSpriteProperty(JsonReader *const r) {
+	if(tokeq(r, "variables")) {
 		puts("variables");
-		parseVariables();
+		parseVariables(r);
 	}
-	else if(tokceq("lists")) {
+	else if(tokeq(r, "lists")) {
 		puts("lists");
-		parseLists();
+		parseLists(r);
 	}
-	else if(tokceq("scripts")) {
+	else if(tokeq(r, "scripts")) {
 		puts("scripts");
-		parseScripts();
+		parseScripts(r);
 	}
-	/*else if(tokceq("costumes")) {
+	else if(tokeq(r, "costumes")) {
 		puts("costumes");
-		parseCostumes();
-		}*/
-	else if(tokceq("scratchX")) {
-		++pos;
-		sprite->xpos = strtod(json+tokens[pos].start, NULL);
-		++pos;
-	}
-	else if(tokceq("scratchY")) {
-		++pos;
-		sprite->ypos = strtod(json+tokens[pos].start, NULL);
-		++pos;
-	}
-	else if(tokceq("scale")) {
-		++pos;
-		sprite->size = strtod(json+tokens[pos].start, NULL);
-		++pos;
-	}
-	else if(tokceq("direction")) {
-		++pos;
-		sprite->direction = strtod(json+tokens[pos].start, NULL);
+		parseCostumes(r);
+	}
+	else if(tokeq(r, "currentCostumeIndex")) {
+		jsonReader_next(r);
+		const double i = tokToFloating(r);
+		sprite->currentCostume = i >= 0.0 && i < UINT16_MAX ? i : 0;
+	}
+	else if(tokeq(r, "scratchX")) {
+		jsonReader_next(r);
+		sprite->xpos = tokToFloating(r);
+	}
+	else if(tokeq(r, "scratchY")) {
+		jsonReader_next(r);
+		sprite->ypos = tokToFloating(r);
+	}
+	else if(tokeq(r, "scale")) {
+		jsonReader_next(r);
+		sprite->size = tokToFloating(r);
+	}
+	else if(tokeq(r, "direction")) {
+		jsonReader_next(r);
+		sprite->direction = tokToFloating(r);
 	}
 	else
 		return false;
@@ -738,14 +902,19 @@ static bool attemptToParseSpriteProperty(void) {
 static inline void initializeSpriteContext(SpriteContext *const c, const enum SpriteScope scope) {
 	c->name = NULL;
 	c->scope = scope;
+	c->threads = NULL;
+	c->nThreads = 0;
+	c->runningThreads = NULL;
 
-	c->variables = NULL;
+	variables_init(&c->variables);
 	c->lists = NULL;
 
 	c->procedureHashTable = NULL;
 	c->whenClonedThreads.array = NULL;
 	c->whenClonedThreads.nThreads = 0;
 	c->broadcastThreadLists = NULL;
+	c->nBroadcastThreadLists = 0;
+	c->clonePool = NULL;
 
 	c->xpos = c->ypos = 0.0;
 	c->direction = 90.0;
@@ -754,9 +923,36 @@ static inline void initializeSpriteContext(SpriteContext *const c, const enum Sp
 		= c->effects.pixelate = c->effects.mosaic
 		= c->effects.fisheye = c->effects.whirl
 		= 0.0;
+
+	c->costumes = NULL;
+	c->nCostumes = c->currentCostume = 0;
 }
 
 static dynarray *sprites; // array containing pointers to all sprites
+static double tempo;
+
+/* Gives every block that names a variable with a constant the slot of the variable instead,
+	 so that it doesn't have to look up the name every time it is run. The name is looked up
+	 the same way the blocks would, first in the sprite the block is in and then in the stage.
+	 Blocks naming a variable that doesn't exist yet are left to look it up while running. */
+static void resolveVariables(void) {
+	SpriteContext *const stage = &(*(struct SpriteLink**)dynarray_front(sprites))->context;
+	struct VariableReference *ref = NULL;
+	while((ref = dynarray_next(variableReferences, ref)) != NULL) {
+		uint16 slot;
+		uint32 onStage = 0;
+		if(variables_find(&ref->sprite->variables, ref->name->data.string, &slot)) {
+			if(variables_find(&stage->variables, ref->name->data.string, &slot))
+				continue;
+			onStage = 1;
+		}
+		free(ref->name->data.string);
+		ref->name->type = FLOATING;
+		ref->name->data.integer = (uint32)slot << 1 | onStage;
+		if(ref->slotFunc != NULL)
+			ref->block->func = ref->slotFunc;
+	}
+}
 
 SpriteContext *newSprite(const enum SpriteScope scope) {
 	struct SpriteLink *const new = malloc(sizeof(struct SpriteLink));
@@ -765,16 +961,9 @@ SpriteContext *newSprite(const enum SpriteScope scope) {
 	return &new->context;
 }
 
-/* Takes a pointer to the JSON in memory, and returns an array of all the blocks (as in
-	 blocks of Blocks and Values) that need to be freed when the player is stopped. */
-void parseJSON(void) {
-	// initialize
-	blockMphf = loadBlockHashFunc();
-
-	charCd = iconv_open("UTF-8", "UTF-32LE"); // LE for little-endian
-	if(charCd == (iconv_t)-1) puts("[ERROR]Could not create encoding conversion descriptor.");
-	dynarray_new(charBuffer, sizeof(char));
-
+/* Makes the collections that sprites, and their threads, are organized into while they are
+	 loaded. */
+static void newCollections(void) {
 	dynarray_new(greenFlagThreads, sizeof(ThreadLink*));
 	broadcastsHashTable = NULL;
 
@@ -784,66 +973,101 @@ void parseJSON(void) {
 	dynarray_new(broadcastThreadLists, sizeof(struct ThreadList*));
 
 	dynarray_new(sprites, sizeof(struct SpriteLink*));
+	tempo = 0.0;
+}
+
+/* Frees the collections that are only needed while sprites are being put together. The
+	 sprites, green flag threads and broadcasts are left for loadIntoRuntime. */
+static void freeCollections(void) {
+	dynarray_free(threads);
+	dynarray_free(threadTypes);
+	dynarray_free(broadcastTypes);
+	dynarray_free(broadcastThreadLists);
+	procedureHashTable = NULL;
+}
+
+/* Parses the JSON in memory, which is jsonLength bytes long, into sprites. */
+static void parseJSON(const size_t jsonLength) {
+	// initialize
+	setVarHash = hash("setVar:to:", 10);
+	appendVarHash = hash("appendVar:with:", 15);
+	concatenateHash = hash("concatenate:with:", 17);
+	joinAllHash = hash("concatenateAll", 14);
+	letterOfHash = hash("letter:of:", 10);
+	letterOfVarHash = hash("letter:ofVar:", 13);
+	stringLengthHash = hash("stringLength:", 13);
+	stringLengthOfVarHash = hash("stringLengthOfVar:", 18);
+	readVariableHash = hash("readVariable", 12);
+	changeVarHash = hash("changeVar:by:", 13);
+	readVariableSlotHash = hash("readVariableSlot", 16);
+	setVarSlotHash = hash("setVarSlot:to:", 14);
+	appendVarSlotHash = hash("appendVarSlot:with:", 19);
+	changeVarSlotHash = hash("changeVarSlot:by:", 17);
+	getParamHash = hash("getParam", 8);
+
+	dynarray_new(charBuffer, sizeof(char));
+
+	newCollections();
+	dynarray_new(variableReferences, sizeof(struct VariableReference));
+	dynarray_new(scriptBlocks, sizeof(Block));
+	dynarray_new(scriptValues, sizeof(Value));
+	dynarray_new(scriptRelocations, sizeof(ubyte));
+	dynarray_new(procedureParameters, sizeof(char*));
 
 	// begin parsing
 	sprite = newSprite(STAGE);
-	ufastest nKeysToGo = tokens[0].size;
-	pos = 1;
-	do {
-		if(!attemptToParseSpriteProperty()) {
-			if(tokceq("children")) {
+	JsonReader reader, *const r = &reader;
+	jsonReader_init(r, json, jsonLength);
+	if(jsonReader_next(r) != JSON_OBJECT)
+		puts("[ERROR]The project.json is not an object.");
+	else while(jsonReader_next(r) > JSON_END) { // for each key
+		if(!attemptToParseSpriteProperty(r)) {
+			if(tokeq(r, "children")) {
 				puts("children");
-				++pos; // advance to array of "children"
-				ufastest nChildrenToGo = TOKC.size;
-				++pos; // advance to first child
-				if(nChildrenToGo != 0) {
-					do {
-						ufastest nSpriteKeysToGo = TOKC.size - 1; // subtract 1 because "objName" is handled outside the loop
-
-						++pos; // advance to first key of next child
-						if(tokceq("objName")) { // if it is a sprite
-							sprite = newSprite(SPRITE);
-
-							// extract sprite name
-							++pos;
-							tokcext(sprite->name);
-							++pos;
-
-							do {
-								if(!attemptToParseSpriteProperty())
-									skip();
-							} while(--nSpriteKeysToGo != 0);
-
+				jsonReader_next(r); // advance to array of "children"
+				while(jsonReader_next(r) > JSON_END) { // for each child
+					if(jsonReader_next(r) == JSON_END) // advance to first key of child, unless it is empty
+						continue;
+					if(tokeq(r, "objName")) { // if it is a sprite
+						sprite = newSprite(SPRITE);
+
+						// extract sprite name
+						jsonReader_next(r);
+						tokext(r, sprite->name);
+
+						while(jsonReader_next(r) > JSON_END) {
+							if(!attemptToParseSpriteProperty(r))
+								skipValue(r);
 						}
-						else { // it is not a sprite
-							--pos; skip();
-						}
-					} while(--nChildrenToGo != 0);
-					sprite = &(*(struct SpriteLink**)dynarray_front(sprites))->context;
+					}
+					else // it is not a sprite
+						jsonReader_finish(r);
 				}
+				sprite = &(*(struct SpriteLink**)dynarray_front(sprites))->context;
 			}
-			else if(tokceq("tempoBPM")) {
-				++pos;
-				setTempo(strtod(json+tokens[pos].start, NULL));
-				++pos;
+			else if(tokeq(r, "tempoBPM")) {
+				jsonReader_next(r);
+				tempo = tokToFloating(r);
 			}
 			else // key isn't significant
-				skip();
+				skipValue(r);
 		}
-	} while(--nKeysToGo != 0);
-	setVolume(100.0);
+	}
+	if(r->type == JSON_ERROR)
+		puts("[ERROR]The project.json ended early.");
 
 	sprite->name = "_stage_";
+	resolveVariables();
 
 	// cleanup
-	cmph_destroy(blockMphf);
 	dynarray_free(charBuffer);
 
-	dynarray_free(threads);
-	dynarray_free(threadTypes);
-	dynarray_free(broadcastTypes);
-	dynarray_free(broadcastThreadLists);
-	procedureHashTable = NULL;
+	freeCollections();
+	dynarray_free(variableReferences);
+	dynarray_free(scriptBlocks);
+	dynarray_free(scriptValues);
+	dynarray_free(scriptRelocations);
+	dynarray_free(procedureParameters);
 }
 
 void loadIntoRuntime(void) {
@@ -851,8 +1075,19 @@ void loadIntoRuntime(void) {
 
 	struct SpriteLink *spriteHashTable = NULL; // hash table of all sprites
 	struct SpriteLink **sprite = NULL;
-	while((sprite = (struct SpriteLink**)dynarray_next(sprites, sprite)) != NULL)
+	while((sprite = (struct SpriteLink**)dynarray_next(sprites, sprite)) != NULL) {
 		HASH_ADD_KEYPTR(hh, spriteHashTable, (*sprite)->context.name, strlen((*sprite)->context.name), *sprite);
+
+		// get the costumes that will be shown first, and the ones after them, ready ahead of time
+		SpriteContext *const c = &(*sprite)->context;
+		if(c->nCostumes == 0)
+			continue;
+		if(c->currentCostume >= c->nCostumes)
+			c->currentCostume = 0;
+		prefetchResource(c->costumes[c->currentCostume].resource);
+		prefetchResource(c->costumes[(c->currentCostume+1) % c->nCostumes].resource);
+	}
+	streamResources(); // read the rest of the resources in the background, while the project runs
 	dynarray_free(sprites);
 	setSprites(spriteHashTable);
 
@@ -862,19 +1097,38 @@ void loadIntoRuntime(void) {
 	setGreenFlagThreads(finalizedThreads, nFinalizedThreads);
 
 	setBroadcastsHashTable(broadcastsHashTable);
+	setTempo(tempo);
+	setVolume(100.0);
 }
 
-bool loadProject(const char *const projectPath) {
+#include "project_image.c"
+
+bool loadProject(const char *const projectPath, const char *const imagePath, const char *const assetCachePath) {
+	if(loadSB2(projectPath, assetCachePath)) return true; // loadSB2 prints its own error message
+
+	struct stat source;
+	if(imagePath != NULL && stat(projectPath, &source) == 0) {
+		if(!loadImage(imagePath, &source)) {
+			loadIntoRuntime();
+			return false;
+		}
+		dynarray_new(imageScripts, sizeof(struct ImageScript));
+	}
+
 	size_t jsonLength;
-	resources = loadSB2(projectPath, (char **)&json, &jsonLength);
-	if(resources == NULL) return true; // loadSB2 prints its own error message
+	if(readProjectJson(&json, &jsonLength)) {
+		closeSB2();
+		return true; // readProjectJson prints its own error message
+	}
+
+	parseJSON(jsonLength);
 
-	tokenizeJson(jsonLength);
-	parseJSON();
+	freeProjectJson(); // the SB2 stays open for the resources
 
-	free(json);
-	free(tokens);
-	free(resources);
+	if(imageScripts != NULL) {
+		saveImage(imagePath, &source);
+		freeImageScripts();
+	}
 
 	loadIntoRuntime();
 	return false;
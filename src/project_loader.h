@@ -1,3 +1,3 @@
 #pragma once
 
-extern bool loadProject(const char *const path);
+extern bool loadProject(const char *const path, const char *const imagePath, const char *const assetCachePath);
@@ -10,9 +10,10 @@
 **/
 
 #include <stdio.h>
+#include <stddef.h>
 #include <math.h>
 #include <time.h>
-#include <cmph.h>
+#include <SDL2/SDL_opengl.h>
 
 #include "types/primitives.h"
 
@@ -23,17 +24,21 @@
 #include "types/value.h"
 #include "types/block.h"
 #include "thread.h"
+#include "types/variables.h"
 #include "types/sprite.h"
+#include "types/costume.h"
 
 #include "runtime.h"
+#include "zip_loader.h"
 
 #include "variables.h"
+#include "utf8.h"
+#include "numparse.h"
 
 #include "strpool.h"
 #include "value.h"
 
 static ThreadContext *activeThread;
-static void *destroy = NULL; // used when the last block to run (actually only bf_destroy_clone) wants to free the memory holding the active thread
 static SpriteContext *activeSprite;
 static dynarray *stack;
 
@@ -225,6 +230,8 @@ static void enterProcedure(const Block *const returnStack) {
 #define isThreadStopped(t) ((t).frame.nextBlock == NULL) // && (t).frame.level == 0 && dynarray_len((t).blockStack) == 0)
 
 static void startThread(ThreadLink *const link) {
+	if(link->thread.cold)
+		threadContext_init(&link->thread, link->thread.topBlock);
 	threadContext_reset(&link->thread);
 	link->thread.frame.nextBlock = link->thread.topBlock;
 	if(link->prev != NULL) // if the thread is already started, don't attempt to readd it to the list
@@ -239,6 +246,14 @@ static void startThread(ThreadLink *const link) {
 	}
 	link->prev = &runningThreads;
 	runningThreads.next = link; // add it to the list of running threads
+
+	// and to the list of running threads of its sprite
+	ThreadLink **const spriteThreads = &link->sprite->runningThreads;
+	link->prevInSprite = NULL;
+	link->nextInSprite = *spriteThreads;
+	if(*spriteThreads != NULL)
+		(*spriteThreads)->prevInSprite = link;
+	*spriteThreads = link;
 }
 
 // start threads using an array of pointers to the threads
@@ -260,32 +275,46 @@ static ThreadLink* stopThread(ThreadLink *const stopped) {
 		next->prev = stopped->prev;
 
 	stopped->prev = stopped->next = NULL;
+
+	if(stopped->prevInSprite != NULL)
+		stopped->prevInSprite->nextInSprite = stopped->nextInSprite;
+	else
+		stopped->sprite->runningThreads = stopped->nextInSprite;
+	if(stopped->nextInSprite != NULL)
+		stopped->nextInSprite->prevInSprite = stopped->prevInSprite;
 	return next;
 }
 
 static void stopAllThreads(void) {
 	ThreadLink *current = &runningThreads,
-		*next;
+		*next, *active = NULL;
 	while(current != NULL) {
 		next = current->next;
 		if(&current->thread == activeThread) {
 			runningThreads.next = current;
 			current->prev = &runningThreads;
+			active = current;
 		}
 		else
 			current->prev =  NULL;
 		current->next = NULL;
+		if(current != &runningThreads)
+			current->sprite->runningThreads = NULL;
 		current = next;
 	}
+	if(active != NULL) { // the active thread is the only one left running
+		active->prevInSprite = active->nextInSprite = NULL;
+		active->sprite->runningThreads = active;
+	}
 }
 
 static void stopThreadsForSprite(void) {
-	ThreadLink *current = runningThreads.next;
+	ThreadLink *current = activeSprite->runningThreads;
 	while(current != NULL) {
-		if(current->sprite == activeSprite && &current->thread != activeThread)
-			current = stopThread(current);
-		else
-			current = current->next;
+		ThreadLink *const next = current->nextInSprite;
+		if(&current->thread != activeThread)
+			stopThread(current);
+		current = next;
 	}
 }
 
@@ -306,6 +335,147 @@ void restartGreenFlagThreads(void) {
 	startThreadsInArray(greenFlagThreads, nGreenFlagThreads);
 }
 
+/**
+	Clones
+
+	Projects that use clones as bullets or particles make and delete hundreds of them a
+	second, so a clone and its threads are allocated together as a CloneRecord. When a clone
+	is deleted, its record is put in the ClonePool of its sprite, to be reused by the next
+	clone of the sprite. Every clone of a sprite has the same threads, so every record in a
+	pool is the same size.
+
+	A reused record keeps what its clone had allocated: the dynarrays of its threads, the
+	array of its variables, and its Lists, which are then just given the values and items of
+	the sprite being cloned. Once a sprite has made as many clones as it will have at once,
+	making and deleting clones doesn't allocate anything.
+
+	The threads of a new clone are cold, and are only initialized when they are first
+	started, because most clones only ever run their "when I start as a clone" scripts.
+	Clones don't have their own ThreadLists for their hats either. A ThreadList of a sprite
+	is used for its clones too, by finding the thread at the same position in the threads of
+	each clone. The live clones of a sprite are kept in a list in its pool for that, from the
+	newest to the oldest.
+**/
+
+struct CloneRecord {
+	struct CloneRecord *next, *prev; // in the list of live clones, or next in the list of deleted ones
+	SpriteContext context;
+	ThreadLink threads[];
+};
+
+#define cloneRecord(clone) ((struct CloneRecord*)((char*)(clone) - offsetof(struct CloneRecord, context)))
+
+/* Returns the clone after sprite, which is either the sprite clones were made of or one of
+	 its clones, or NULL if there isn't one. The clones come after the sprite. */
+static inline SpriteContext* nextClone(const SpriteContext *const sprite) {
+	const struct CloneRecord *next;
+	if(sprite->scope == CLONE)
+		next = cloneRecord(sprite)->next;
+	else
+		next = sprite->clonePool == NULL ? NULL : sprite->clonePool->live;
+	return next == NULL ? NULL : (SpriteContext*)&next->context;
+}
+
+/* Gets the thread of a clone (or of the sprite itself) that is at the same position as
+	 thread is in the threads of the sprite it belongs to. */
+#define cloneThread(clone, thread) ((clone)->threads + ((thread) - (thread)->sprite->threads))
+
+static struct ClonePool* newClonePool(SpriteContext *const sprite) {
+	struct ClonePool *const pool = malloc(sizeof(struct ClonePool));
+	if(pool == NULL) {
+		puts("[ERROR]Could not allocate pool of clones.");
+		return NULL;
+	}
+	pool->free = pool->live = NULL;
+	pool->sprite = sprite;
+	pool->recordSize = sizeof(struct CloneRecord) + sprite->nThreads*sizeof(ThreadLink);
+	return pool;
+}
+
+/* Makes a clone of a sprite, reusing a deleted clone of it if there is one. Returns NULL
+	 if the clone could not be made. */
+static SpriteContext* newClone(SpriteContext *const parent) {
+	if(parent->clonePool == NULL) {
+		parent->clonePool = newClonePool(parent);
+		if(parent->clonePool == NULL)
+			return NULL;
+	}
+	struct ClonePool *const pool = parent->clonePool;
+	struct CloneRecord *record = pool->free;
+	const bool reused = record != NULL;
+	if(reused)
+		pool->free = record->next;
+	else {
+		record = malloc(pool->recordSize);
+		if(record == NULL) {
+			puts("[ERROR]Could not allocate clone.");
+			return NULL;
+		}
+	}
+	SpriteContext *const clone = &record->context;
+
+	Variables variables = {.values = NULL, .capacity = 0};
+	List *lists = NULL;
+	if(reused) { // what the record kept from its last clone
+		variables = clone->variables;
+		lists = clone->lists;
+	}
+
+	memcpy(clone, parent, sizeof(SpriteContext));
+	clone->scope = CLONE;
+	clone->runningThreads = NULL;
+
+	clone->threads = record->threads;
+	for(uint16 i = 0; i < clone->nThreads; ++i) {
+		ThreadLink *link = clone->threads+i;
+		if(!reused) // a reused thread is either still cold or is reset when it is started
+			threadContext_initCold(&link->thread, parent->threads[i].thread.topBlock);
+		link->sprite = clone;
+		link->prev = link->next = NULL;
+	}
+
+	if(reused)
+		recopyLists(&lists, (const List *const *const)&parent->lists);
+	else
+		lists = copyLists((const List *const *const)&parent->lists);
+	clone->variables = variables;
+	variables_copy(&clone->variables, &parent->variables);
+	clone->lists = lists;
+
+	record->prev = NULL;
+	record->next = pool->live;
+	if(pool->live != NULL)
+		pool->live->prev = record;
+	pool->live = record;
+	return clone;
+}
+
+/* Deletes a clone by putting it in the pool of its sprite. Its threads must have been
+	 stopped, except for the active thread, which is left to end once the block deleting the
+	 clone returns. The record isn't reused until another clone is made, so the active thread
+	 can still be unlinked from the running threads after that. */
+static void deleteClone(SpriteContext *const clone) {
+	for(uint16 i = 0; i < clone->nThreads; ++i) {
+		if(!clone->threads[i].thread.cold)
+			threadContext_reset(&clone->threads[i].thread); // also makes the active thread end, even if it is in a substack or procedure
+	}
+
+	variables_clear(&clone->variables);
+	clearLists(&clone->lists);
+
+	struct ClonePool *const pool = clone->clonePool;
+	struct CloneRecord *const record = cloneRecord(clone);
+	if(record->prev != NULL)
+		record->prev->next = record->next;
+	else
+		pool->live = record->next;
+	if(record->next != NULL)
+		record->next->prev = record->prev;
+
+	record->next = pool->free;
+	pool->free = record;
+}
+
 static struct BroadcastThreads *broadcastsHashTable = NULL;
 
 void setBroadcastsHashTable(struct BroadcastThreads *const hashTable) {
@@ -340,12 +510,15 @@ static bool startBroadcastThreads(const char *const msg, const size_t msgLen, st
 	struct ThreadList *threadList;
 	ThreadLink **threadLink;
 	THREADLIST_ITER(broadcastThreadsLink->threadList, threadList) {
-		threadLink = threadList->array+0;
-		for(uint16 i = 0; i < threadList->nThreads; ++i) {
-			if(&(*threadLink)->thread == activeThread)
-				r = true;
-			startThread(*threadLink);
-			++threadLink;
+		for(SpriteContext *s = threadList->array[0]->sprite; s != NULL; s = nextClone(s)) {
+			threadLink = threadList->array+0;
+			for(uint16 i = 0; i < threadList->nThreads; ++i) {
+				ThreadLink *const thread = cloneThread(s, *threadLink);
+				if(&thread->thread == activeThread)
+					r = true;
+				startThread(thread);
+				++threadLink;
+			}
 		}
 	}
 	/*dynarray *threads = broadcastThreadsLink->threads;
@@ -409,6 +582,7 @@ static inline SpriteContext *getSprite(const char *const name, const size_t len)
 /** Include the runtime library and hash value table **/
 #include "runtime_lib.c"
 #include "blockhash/opstable.c"
+const uint32 nOps = sizeof(opsTable)/sizeof(*opsTable);
 
 /* basically `evalCmd` in the Flash version */
 static const Block* interpret(const Block *block, Value *const reportSlot, const ufastest level) {
@@ -486,10 +660,6 @@ bool stepThreads(void) {
 			// step the thread
 			if(stepActiveThread()) { // if the thread should be killed
 				current = stopThread(current);
-				if(destroy != NULL) {
-					free(destroy);
-					destroy = NULL;
-				}
 
 				if(runningThreads.next == NULL)
 					return false;
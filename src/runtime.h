@@ -17,6 +17,7 @@ struct ProcedureLink {
 extern bool doRedraw;
 
 extern const blockfunc opsTable[];
+extern const uint32 nOps;
 
 extern void initializeAskPrompt(void);
 
@@ -9,11 +9,6 @@
 	This file is meant to just be included in another C file rather than linked.
 **/
 
-/*
-	TODO
-		***make string manupulation utf-8 compatible***
-*/
-
 #define BF(name) static const Block* bf_##name(const Block *const block, Value *const reportSlot, const Value arg[])
 
 BF(noop) {
@@ -158,8 +153,8 @@ BF(generate_random) {
 }
 
 BF(compute_math_function) {
-	char *function;
-	toString(arg+0, &function);
+	const char *function;
+	toStringView(arg+0, &function);
 
 	switch(function[1]) { // switch with the second letter
 	case 'b': // abs
@@ -229,38 +224,131 @@ BF(compute_math_function) {
 }
 
 BF(concatenate) {
-	char *arg0, *arg1, *r;
-	toString(arg+0, &arg0);
-	toString(arg+1, &arg1);
-	r = strpool_alloc(strlen(arg0) + strlen(arg1) + 1);
-	strcpy(r, arg0);
-	strcat(r, arg1);
+	const char *arg0, *arg1;
+	const size_t len0 = toStringView(arg+0, &arg0);
+	const size_t len1 = toStringView(arg+1, &arg1);
+	char *const r = strpool_alloc(len0 + len1 + 1);
+	memcpy(r, arg0, len0);
+	memcpy(r+len0, arg1, len1+1);
 
 	reportSlot->type = STRING;
 	reportSlot->data.string = r;
 	return NULL;
 }
 
+// nested joins flattened into one block, see parseJoinArguments in project_loader.c
+BF(concatenate_all) {
+	const uint16 nArgs = block->p.nArgs;
+	const char *parts[nArgs];
+	size_t lengths[nArgs], total = 0;
+	for(uint16 i = 0; i < nArgs; ++i)
+		total += lengths[i] = toStringView(arg+i, parts+i);
+
+	char *r = strpool_alloc(total + 1);
+	reportSlot->type = STRING;
+	reportSlot->data.string = r;
+	for(uint16 i = 0; i < nArgs; ++i) {
+		memcpy(r, parts[i], lengths[i]);
+		r += lengths[i];
+	}
+	*r = '\0';
+	return NULL;
+}
+
 BF(get_string_length) {
-	char *s;
-	toString(arg+0, &s);
-	int64 l = strlen(s);
+	const char *s;
+	const size_t len = toStringView(arg+0, &s);
 
 	reportSlot->type = FLOATING;
-	reportSlot->data.floating = (double)l;
+	reportSlot->data.floating = (double)utf8_count(s, len);
 	return NULL;
 }
 
-BF(get_character) {
-	int64 index = toInteger(arg+0) - 1; // subtract one because Scratch indices start at one, not zero
-	char *s;
-	toString(arg+1, &s);
-
-	char *r = strpool_alloc(2);
-	r[0] = s[index];
-	r[1] = '\0';
+/* reports the character found by utf8_charAt or utf8Index_charAt, which is an empty string if there wasn't one */
+static inline void reportCharacter(Value *const reportSlot, const char *const ch, const size_t len) {
+	char *const r = strpool_alloc(len+1);
+	memcpy(r, ch, len);
+	r[len] = '\0';
 	reportSlot->type = STRING;
 	reportSlot->data.string = r;
+}
+
+BF(get_character) {
+	const int64 index = toInteger(arg+0) - 1; // subtract one because Scratch indices start at one, not zero
+	const char *s, *ch = "";
+	const size_t len = toStringView(arg+1, &s);
+
+	size_t chLen = 0;
+	if(index >= 0)
+		chLen = utf8_charAt(s, len, index, &ch);
+	reportCharacter(reportSlot, ch, chLen);
+	return NULL;
+}
+
+/* Finds a variable by its name in the active sprite, and then in the stage, for the blocks
+	 that name a variable with something only known while running. If neither has it, it is
+	 made in the active sprite. Returns the variables it is in, and its slot in *slot. */
+static Variables* findVariable(const Value *const nameArg, uint16 *const slot) {
+	const char *name;
+	const size_t nameLen = toStringView(nameArg, &name);
+	if(!variables_find(&activeSprite->variables, name, slot))
+		return &activeSprite->variables;
+	if(!variables_find(&stage->variables, name, slot))
+		return &stage->variables;
+	*slot = variable_new(&activeSprite->variables, name, nameLen, NULL);
+	return &activeSprite->variables;
+}
+
+/* Blocks that name a variable with a constant have it replaced by the variable's slot when
+	 the project is loaded (see resolveVariables in project_loader.c). The slot is stored as
+	 an integer shifted left by one, with the low bit set if it is a slot in the stage. */
+static inline Variables* variableAt(const Value *const slotArg, uint16 *const slot) {
+	*slot = slotArg->data.integer >> 1;
+	return (slotArg->data.integer & 1) != 0 ? &stage->variables : &activeSprite->variables;
+}
+
+/* Gets the value of a variable for `length of (var)` and `letter (i) of (var)`, along with
+	 an index of its characters if it is a string. See parseBlock in project_loader.c. These
+	 blocks are only made by the loader, so the argument is either the name of the variable
+	 as a string, or its slot if the loader could find it. */
+static Value getVariableForStringBlock(const Value *const nameArg, const Utf8Index **const index) {
+	uint16 slot;
+	Variables *const variables = nameArg->type == STRING ? findVariable(nameArg, &slot) : variableAt(nameArg, &slot);
+	return getVariableUtf8IndexAt(variables, slot, index);
+}
+
+BF(get_string_length_of_variable) {
+	const Utf8Index *index;
+	const Value value = getVariableForStringBlock(arg+0, &index);
+
+	reportSlot->type = FLOATING;
+	if(index != NULL)
+		reportSlot->data.floating = (double)index->nChars;
+	else {
+		const char *s;
+		const size_t len = toStringView(&value, &s);
+		reportSlot->data.floating = (double)utf8_count(s, len);
+	}
+	return NULL;
+}
+
+BF(get_character_of_variable) {
+	const int64 i = toInteger(arg+0) - 1;
+	const Utf8Index *index;
+	const Value value = getVariableForStringBlock(arg+1, &index);
+
+	const char *ch = "";
+	size_t chLen = 0;
+	if(i >= 0) {
+		if(index != NULL)
+			chLen = utf8Index_charAt(index, value.data.string, i, &ch);
+		else {
+			const char *s;
+			const size_t len = toStringView(&value, &s);
+			chLen = utf8_charAt(s, len, i, &ch);
+		}
+	}
+	reportCharacter(reportSlot, ch, chLen);
 	return NULL;
 }
 
@@ -346,8 +434,8 @@ BF(do_forever) {
 }
 
 BF(stop_scripts) {
-	char *str;
-	toString(arg+0, &str);
+	const char *str;
+	toStringView(arg+0, &str);
 	switch(str[0]) {
 	case 'o': // other scripts in sprite
 		stopThreadsForSprite();
@@ -360,32 +448,12 @@ BF(stop_scripts) {
 
 BF(clone) {
 	if(activeSprite->scope != STAGE) {
-		SpriteContext *clone = malloc(sizeof(SpriteContext));
-		memcpy(clone, activeSprite, sizeof(SpriteContext));
-		clone->scope = CLONE;
-
-		clone->threads = malloc(activeSprite->nThreads*sizeof(ThreadLink)); // don't check for 0 threads because it must have at least one to even be creating clones
-		clone->nThreads = activeSprite->nThreads;
-		for(uint16 i = 0; i < clone->nThreads; ++i) {
-			ThreadLink *link = clone->threads+i;
-			threadContext_init(&link->thread, activeSprite->threads[i].thread.topBlock);
-			link->sprite = clone;
-			link->prev = link->next = NULL;
+		SpriteContext *const clone = newClone(activeSprite);
+		if(clone != NULL) {
+			const ThreadList *const whenCloned = &clone->clonePool->sprite->whenClonedThreads;
+			for(uint16 i = 0; i < whenCloned->nThreads; ++i)
+				startThread(cloneThread(clone, whenCloned->array[i]));
 		}
-
-		clone->variables = copyVariables((const Variable *const *const)&activeSprite->variables); // not sure why the typecast is needed to suppress warinings
-		clone->lists = copyLists((const List *const *const)&activeSprite->lists);
-
-		threadList_copyArray(&clone->whenClonedThreads, &activeSprite->whenClonedThreads, clone->threads, activeSprite->threads);
-		if(clone->nBroadcastThreadLists != 0) {
-			clone->broadcastThreadLists = malloc(clone->nBroadcastThreadLists*sizeof(ThreadList*));
-			for(uint16 i = 0; i < clone->nBroadcastThreadLists; ++i) {
-				clone->broadcastThreadLists[i] = threadList_copy(activeSprite->broadcastThreadLists[i], clone->threads, activeSprite->threads);
-				threadList_insert(activeSprite->broadcastThreadLists[i], clone->broadcastThreadLists[i]);
-			}
-		}
-
-		startThreadsInList(&clone->whenClonedThreads);
 	}
 	return block->p.next;
 }
@@ -393,131 +461,118 @@ BF(clone) {
 BF(destroy_clone) {
 	if(activeSprite->scope == CLONE) {
 		stopThreadsForSprite();
-
-		for(uint16 i = 0; i < activeSprite->nThreads; ++i)
-			threadContext_done(&activeSprite->threads[i].thread);
-		destroy = activeSprite->threads;
-
-		freeVariables(&activeSprite->variables);
-		freeLists(&activeSprite->lists);
-
-		threadList_done(&activeSprite->whenClonedThreads);
-		for(uint16 i = 0; i < activeSprite->nBroadcastThreadLists; ++i) {
-			threadList_remove(NULL, activeSprite->broadcastThreadLists[i]);
-			threadList_free(activeSprite->broadcastThreadLists[i]);
-		}
-
-		free(activeSprite);
+		deleteClone(activeSprite);
 	}
 	return block->p.next;
 }
 
 /* Data */
 
+static void changeVariable(Variables *const variables, const uint16 slot, const Value *const incr) {
+	Value value = getVariableAt(variables, slot);
+	value.data.floating = toFloating(&value) + toFloating(incr);
+	value.type = FLOATING;
+	setVariableAt(variables, slot, &value);
+}
+
 BF(get_variable) {
-	char *name;
-	const size_t nameLen = toString(arg+0, &name);
-	if(getVariable(&activeSprite->variables, name, reportSlot)) {
-		if(getVariable(&stage->variables, name, reportSlot)) {
-			variable_new(&activeSprite->variables, name, nameLen, NULL);
-		}
-	}
+	uint16 slot;
+	Variables *const variables = findVariable(arg+0, &slot);
+	*reportSlot = getVariableAt(variables, slot);
 	return NULL;
 }
 
 BF(variable_set) {
-	char *name;
-	const size_t nameLen = toString(arg+0, &name);
-	if(setVariable(&activeSprite->variables, name, arg+1)) {
-		if(setVariable(&stage->variables, name, arg+1))
-			variable_new(&activeSprite->variables, name, nameLen, arg+1);
-	}
+	uint16 slot;
+	Variables *const variables = findVariable(arg+0, &slot);
+	setVariableAt(variables, slot, arg+1);
+	return block->p.next;
+}
+
+// `set [var] to (join (var) [...])`, see isSelfJoin in project_loader.c
+BF(variable_append) {
+	uint16 slot;
+	Variables *const variables = findVariable(arg+0, &slot);
+	const char *str;
+	const size_t len = toStringView(arg+1, &str);
+	appendToVariableAt(variables, slot, str, len);
 	return block->p.next;
 }
 
 BF(variable_change) {
-	char *name;
-	const size_t nameLen = toString(arg+0, &name);
-
-	Value value;
-	Variable **variables = &activeSprite->variables;
-	if(getVariable(&activeSprite->variables, name, &value)) {
-		if(getVariable(&stage->variables, name, &value))
-			variable_new(&activeSprite->variables, name, nameLen, NULL);
-		else
-			variables = &stage->variables;
-	}
-	double incr = toFloating(arg+1);
-	value.data.floating = toFloating(&value);
-	value.data.floating += incr;
-	value.type = FLOATING;
-	setVariable(variables, name, &value);
+	uint16 slot;
+	Variables *const variables = findVariable(arg+0, &slot);
+	changeVariable(variables, slot, arg+1);
+	return block->p.next;
+}
+
+BF(get_variable_slot) {
+	uint16 slot;
+	Variables *const variables = variableAt(arg+0, &slot);
+	*reportSlot = getVariableAt(variables, slot);
+	return NULL;
+}
+
+BF(variable_set_slot) {
+	uint16 slot;
+	Variables *const variables = variableAt(arg+0, &slot);
+	setVariableAt(variables, slot, arg+1);
+	return block->p.next;
+}
+
+BF(variable_append_slot) {
+	uint16 slot;
+	Variables *const variables = variableAt(arg+0, &slot);
+	const char *str;
+	const size_t len = toStringView(arg+1, &str);
+	appendToVariableAt(variables, slot, str, len);
+	return block->p.next;
+}
 
+BF(variable_change_slot) {
+	uint16 slot;
+	Variables *const variables = variableAt(arg+0, &slot);
+	changeVariable(variables, slot, arg+1);
 	return block->p.next;
 }
 
 #define getOrCreateList(name, nameLen, list) {										\
-		if(getListContents(&activeSprite->lists, name, &list)) {			\
-			if(getListContents(&stage->lists, name, &list))							\
+		if(getList(&activeSprite->lists, name, &list)) {			\
+			if(getList(&stage->lists, name, &list))							\
 				list = list_new(&activeSprite->lists, name, nameLen);			\
 		}																															\
 	}
 
-// TODO: this might be inefficient
 BF(list_getContents) {
-	char *str;
-	size_t nRequiredChars = toString(arg+0, &str);
-
-	UT_array *list;
-	getOrCreateList(str, nRequiredChars, list);
+	const char *name;
+	const size_t nameLen = toStringView(arg+0, &name);
+	List *list;
+	getOrCreateList(name, nameLen, list);
 
-	char **elements = malloc(utarray_len(list)*sizeof(char**));
-	if(elements == NULL) {
+	const char *const contents = listGetContents(list);
+	if(contents == NULL) {
 		reportSlot->data.floating = 0.0;
 		reportSlot->type = FLOATING;
-		puts("[ERROR]Could not allocate list of strings in bf_list_getContents.");
 		return NULL;
 	}
-	nRequiredChars = 0;
-	for(uint32 i = 0; i < utarray_len(list); ++i)
-		nRequiredChars += toString((Value*)utarray_eltptr(list, i), elements+i);
-
-	if(nRequiredChars != utarray_len(list))
-		nRequiredChars += utarray_len(list); // make room for spaces
-	++nRequiredChars; // make room for terminator
-	str = strpool_alloc(nRequiredChars);
-	reportSlot->data.string = str;
+	reportSlot->data.string = (char*)contents;
 	reportSlot->type = STRING;
-
-	if(nRequiredChars == utarray_len(list) + 1) { // if each element is a single character
-		for(uint32 i = 0; i < utarray_len(list); ++i)
-			str = stpcpy(str, elements[i]);
-	}
-	else {
-		for(uint32 i = 0; i < utarray_len(list); ++i) {
-			str = stpcpy(str, elements[i]);
-			*(str++) = ' ';
-		}
-		*(str-1) = '\0';
-	}
-
-	free(elements);
 	return NULL;
 }
 
 BF(list_append) {
-	char *name;
-	const size_t nameLen = toString(arg+1, &name);
-	UT_array *list;
+	const char *name;
+	const size_t nameLen = toStringView(arg+1, &name);
+	List *list;
 	getOrCreateList(name, nameLen, list);
 	listAppend(list, arg+0);
 	return block->p.next;
 }
 
 BF(list_delete) {
-	char *name;
-	const size_t nameLen = toString(arg+1, &name);
-	UT_array *list;
+	const char *name;
+	const size_t nameLen = toStringView(arg+1, &name);
+	List *list;
 	getOrCreateList(name, nameLen, list);
 	if(arg[0].type == STRING) {
 		switch(arg[0].data.string[0]) {
@@ -533,16 +588,16 @@ BF(list_delete) {
 }
 
 BF(list_insert) {
-	char *name;
-	const size_t nameLen = toString(arg+1, &name);
-	UT_array *list;
+	const char *name;
+	const size_t nameLen = toStringView(arg+1, &name);
+	List *list;
 	getOrCreateList(name, nameLen, list);
 	if(arg[0].type == STRING) {
 		switch(arg[0].data.string[0]) {
 		case '1': listPrepend(list, arg+2); return block->p.next;
 		case 'l': listAppend(list, arg+2); return block->p.next;
 		case 'r':
-			listInsert(list, arg+2, (uint32)round((double)rand()/RAND_MAX * utarray_len(list)));
+			listInsert(list, arg+2, (uint32)round((double)rand()/RAND_MAX * listLength(list)));
 			return block->p.next;
 		}
 	}
@@ -553,16 +608,16 @@ BF(list_insert) {
 }
 
 BF(list_setElement) {
-	char *name;
-	const size_t nameLen = toString(arg+1, &name);
-	UT_array *list;
+	const char *name;
+	const size_t nameLen = toStringView(arg+1, &name);
+	List *list;
 	getOrCreateList(name, nameLen, list);
 	if(arg[0].type == STRING) {
 		switch(arg[0].data.string[0]) {
 		case '1': listSetFirst(list, arg+2); return block->p.next;
 		case 'l': listSetLast(list, arg+2); return block->p.next;
 		case 'r':
-			listSet(list, arg+2, (uint32)round((double)rand()/RAND_MAX * utarray_len(list)));
+			listSet(list, arg+2, (uint32)round((double)rand()/RAND_MAX * listLength(list)));
 			return block->p.next;
 		}
 	}
@@ -573,16 +628,16 @@ BF(list_setElement) {
 }
 
 BF(list_getElement) {
-	char *name;
-	const size_t nameLen = toString(arg+1, &name);
-	UT_array *list;
+	const char *name;
+	const size_t nameLen = toStringView(arg+1, &name);
+	List *list;
 	getOrCreateList(name, nameLen, list);
 	if(arg[0].type == STRING) {
 		switch(arg[0].data.string[0]) {
 		case '1': *reportSlot = listGetFirst(list); return block->p.next;
 		case 'l': *reportSlot = listGetLast(list); return block->p.next;
 		case 'r':
-			*reportSlot = listGet(list, (uint32)round((double)rand()/RAND_MAX * utarray_len(list)));
+			*reportSlot = listGet(list, (uint32)round((double)rand()/RAND_MAX * listLength(list)));
 			return block->p.next;
 		}
 	}
@@ -593,9 +648,9 @@ BF(list_getElement) {
 }
 
 BF(list_contains) {
-	char *name;
-	const size_t nameLen = toString(arg+0, &name);
-	UT_array *list;
+	const char *name;
+	const size_t nameLen = toStringView(arg+0, &name);
+	List *list;
 	getOrCreateList(name, nameLen, list);
 	Value value = extractSimplifiedValue(arg+1);
 	switch(value.type) {
@@ -615,20 +670,20 @@ BF(list_contains) {
 }
 
 BF(list_length) {
-	char *name;
-	const size_t nameLen = toString(arg+0, &name);
-	UT_array *list;
+	const char *name;
+	const size_t nameLen = toStringView(arg+0, &name);
+	List *list;
 	getOrCreateList(name, nameLen, list);
 	reportSlot->type = FLOATING;
-	reportSlot->data.floating = (double)utarray_len(list);
+	reportSlot->data.floating = (double)listLength(list);
 	return NULL;
 }
 
 /* Custom Blocks (More Blocks, but no extensions) */
 
 BF(call) {
-	char *procName;
-	const size_t procNameLen = toString(arg+0, &procName);
+	const char *procName;
+	const size_t procNameLen = toStringView(arg+0, &procName);
 	const struct ProcedureLink *const procedure = getProcedure(procName, procNameLen);
 
 	dynarray_push_back(&activeThread->nParametersStack, (void*)&procedure->nParameters);
@@ -648,8 +703,8 @@ BF(getParam) {
 /* Events */
 
 BF(broadcast) {
-	char *msg;
-	size_t msgLen = toString(arg+0, &msg);
+	const char *msg;
+	size_t msgLen = toStringView(arg+0, &msg);
 	if(startBroadcastThreads(msg, msgLen, NULL)) {
 		doYield = true;
 		return activeThread->topBlock;
@@ -671,8 +726,8 @@ BF(broadcast) {
 // being written when it shouldn't be. Did I mention that this has to do with pointers?
 BF(broadcast_and_wait) {
 	if(allocTmpData(block))	{
-		char *msg;
-		size_t msgLen = toString(arg+0, &msg);
+		const char *msg;
+		size_t msgLen = toStringView(arg+0, &msg);
 		doYield = true;
 		if(startBroadcastThreads(msg, msgLen, (struct BroadcastThreads**)&getTmpDataPointer()->d.p)) // set the counter to the number of broadcast threads
 			return activeThread->topBlock;
@@ -687,13 +742,15 @@ BF(broadcast_and_wait) {
 			struct ThreadList *threadList;
 			ThreadLink **threadLink;
 			THREADLIST_ITER(broadcastLink->threadList, threadList) {
-				threadLink = threadList->array+0;
-				for(uint16 i = 0; i < threadList->nThreads; ++i) {
-					if(!isThreadStopped((*threadLink)->thread)) {
-						doYield = true;
-						return block;
+				for(SpriteContext *s = threadList->array[0]->sprite; s != NULL; s = nextClone(s)) {
+					threadLink = threadList->array+0;
+					for(uint16 i = 0; i < threadList->nThreads; ++i) {
+						if(!isThreadStopped(cloneThread(s, *threadLink)->thread)) {
+							doYield = true;
+							return block;
+						}
+						++threadLink;
 					}
-					++threadLink;
 				}
 			}
 			broadcastLink->nullifyOnRestart = NULL; // empty this field out so that when the message is broadcast again we don't overwrite memory
@@ -705,8 +762,8 @@ BF(broadcast_and_wait) {
 /* Sensing */
 
 BF(prompt) { // TODO: this is a temporary command line based implementation until graphics are implemented
-	char *msg;
-	toString(arg+0, &msg);
+	const char *msg;
+	toStringView(arg+0, &msg);
 	printf("%s prompts: %s\n>> ", activeSprite->name, msg);
 	fgets(askResponse.d, 1024, stdin);
 	askResponse.i = strlen(askResponse.d);
@@ -733,8 +790,8 @@ BF(timer_reset) {
 }
 
 BF(distanceToSprite) { // TODO: distance to _mouse_
-	char *spriteName;
-	const size_t nameLen = toString(arg+0, &spriteName);
+	const char *spriteName;
+	const size_t nameLen = toStringView(arg+0, &spriteName);
 	const SpriteContext *const target = getSprite(spriteName, nameLen);
 	if(target == NULL)
 		reportSlot->data.floating = 0.0;
@@ -746,12 +803,12 @@ BF(distanceToSprite) { // TODO: distance to _mouse_
 
 // TODO: optimize
 BF(attribute_get) {
-	char *attribute, *spriteName;
+	const char *attribute, *spriteName;
 
-	size_t len = toString(arg+1, &spriteName);
+	size_t len = toStringView(arg+1, &spriteName);
 	SpriteContext *const sprite = getSprite(spriteName, len);
 
-	len = toString(arg+0, &attribute);
+	len = toStringView(arg+0, &attribute);
 
 #define RETURN_NONE() {reportSlot->type = FLOATING; reportSlot->data.floating = 0.0; return NULL;}
 #define RETURN_FLOAT(att) {reportSlot->type = FLOATING; reportSlot->data.floating = sprite->att; return NULL;}
@@ -759,7 +816,7 @@ BF(attribute_get) {
 		if(strncmp("x position", attribute, len) == 0) RETURN_FLOAT(xpos);
 		if(strncmp("y position", attribute, len) == 0) RETURN_FLOAT(ypos);
 		if(strncmp("direction", attribute, len) == 0) RETURN_FLOAT(direction);
-		if(strncmp("costume #", attribute, len) == 0) RETURN_NONE(); // TODO
+		if(strncmp("costume #", attribute, len) == 0) RETURN_FLOAT(currentCostume + 1);
 		if(strncmp("costume name", attribute, len) == 0) RETURN_NONE();
 		if(strncmp("size", attribute, len) == 0) RETURN_FLOAT(size * 100);
 	}
@@ -946,8 +1003,8 @@ BF(y_get) {
 /* Looks */
 
 BF(say) {
-	char *msg;
-	toString(arg+0, &msg);
+	const char *msg;
+	toStringView(arg+0, &msg);
 	printf("%s: %s\n", activeSprite->name, msg);
 	doRedraw = true;
 	return block->p.next;
@@ -956,8 +1013,8 @@ BF(say) {
 BF(say_and_do_wait) {
 	if(allocTmpData(block)) {
 		fsetTmpData((float)toFloating(arg+0) * CLOCKS_PER_SEC);
-		char *msg;
-		toString(arg+0, &msg);
+		const char *msg;
+		toStringView(arg+0, &msg);
 		printf("%s: %s\n", activeSprite->name, msg);
 	}
 	else if (fgetTmpData() > 0) {
@@ -973,8 +1030,8 @@ BF(say_and_do_wait) {
 }
 
 BF(think) {
-	char *msg;
-	toString(arg+0, &msg);
+	const char *msg;
+	toStringView(arg+0, &msg);
 	printf("%s thinks: %s\n", activeSprite->name, msg);
 	return block->p.next;
 }
@@ -982,8 +1039,8 @@ BF(think) {
 BF(think_and_do_wait) {
 	if(allocTmpData(block)) {
 		fsetTmpData((float)toFloating(arg+0) * CLOCKS_PER_SEC);
-		char *msg;
-		toString(arg+0, &msg);
+		const char *msg;
+		toStringView(arg+0, &msg);
 		printf("%s thinks: %s\n", activeSprite->name, msg);
 	}
 	else if (fgetTmpData() > 0) {
@@ -998,9 +1055,90 @@ BF(think_and_do_wait) {
 	return block;
 }
 
+/* Wraps a 0-based costume index around like Scratch does. */
+static uint16 wrapCostumeIndex(double i) {
+	const double n = activeSprite->nCostumes;
+	i = isfinite(i) ? fmod(round(i), n) : 0.0;
+	if(i < 0.0) i += n;
+	return i;
+}
+
+/* Makes the costume whose index is in the thread's tmp data the active sprite's current
+	 costume, and prefetches the costume after it, since costumes are mostly gone through in
+	 order. If the costume's image hasn't been read yet, the thread waits for it instead, by
+	 yielding and running the block again, so that the rest of the project keeps running
+	 while it is read. */
+static const Block* switchCostume(const Block *const block) {
+	const uint16 i = ugetTmpData();
+	if(!resourceReady(activeSprite->costumes[i].resource)) {
+		doYield = true;
+		return block;
+	}
+	freeTmpData();
+	activeSprite->currentCostume = i;
+	getResource(activeSprite->costumes[i].resource);
+	prefetchResource(activeSprite->costumes[(i+1) % activeSprite->nCostumes].resource);
+	doRedraw = true;
+	return block->p.next;
+}
+
+/* Finds the costume that the argument of `switch costume to` names, by its name or its
+	 number. Returns true if there isn't one. */
+static bool findCostume(const Value *const arg, uint16 *const index) {
+	if(arg->type != STRING) {
+		*index = wrapCostumeIndex(toFloating(arg) - 1.0);
+		return false;
+	}
+	struct Costume *costumes = activeSprite->costumes, *costume;
+	const char *const name = arg->data.string;
+	double i;
+	HASH_FIND_STR(costumes, name, costume);
+	if(costume != NULL)
+		*index = costume - costumes;
+	else if(strcmp(name, "next costume") == 0)
+		*index = wrapCostumeIndex(activeSprite->currentCostume + 1.0);
+	else if(strcmp(name, "previous costume") == 0)
+		*index = wrapCostumeIndex(activeSprite->currentCostume - 1.0);
+	else if(strnToFloating(name, strlen(name), &i))
+		*index = wrapCostumeIndex(i - 1.0);
+	else
+		return true;
+	return false;
+}
+
+/* The costume is found only the first time the block is run, since the argument is left
+	 over from an earlier frame if it is run again while waiting for the image. */
+BF(costume_set) {
+	if(activeSprite->nCostumes == 0)
+		return block->p.next;
+	if(allocTmpData(block)) {
+		uint16 i;
+		if(findCostume(arg+0, &i)) {
+			freeTmpData();
+			return block->p.next;
+		}
+		usetTmpData(i);
+	}
+	return switchCostume(block);
+}
+
+BF(costume_next) {
+	if(activeSprite->nCostumes == 0)
+		return block->p.next;
+	if(allocTmpData(block))
+		usetTmpData(wrapCostumeIndex(activeSprite->currentCostume + 1.0));
+	return switchCostume(block);
+}
+
+BF(costume_get) {
+	reportSlot->type = FLOATING;
+	reportSlot->data.floating = activeSprite->currentCostume + 1;
+	return NULL;
+}
+
 BF(gfx_change) { // TODO: check if Scratch bounds some of these
-	char *fxName;
-	toString(arg+0, &fxName);
+	const char *fxName;
+	toStringView(arg+0, &fxName);
 	const double diff = toFloating(arg+1);
 	switch(fxName[0]) {
 	case 'c': // color
@@ -1030,8 +1168,8 @@ BF(gfx_change) { // TODO: check if Scratch bounds some of these
 }
 
 BF(gfx_set) {
-	char *fxName;
-	toString(arg+0, &fxName);
+	const char *fxName;
+	toStringView(arg+0, &fxName);
 	const double newValue = toFloating(arg+1);
 	switch(fxName[0]) {
 	case 'c': // color
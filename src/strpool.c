@@ -3,7 +3,7 @@
 			strpool.h
 
 	This string "pool" is for allocating strings to be freed all at once.
-	The name is not the best.
+	The name is not the best; it is really an arena.
 
 	Currently, this is used only for strings allocated during evaluation of
 	a single block's arguments.
@@ -35,63 +35,107 @@ char* extractString(const char *const str, size_t *const len) {
 	return newString;
 }
 
-struct Link {
-	char *str;
-	struct Link *next;
+/**
+	The pool is a bump allocator over a chain of chunks. Allocating just advances a pointer
+	through the current chunk, moving on to the next chunk in the chain when it runs out.
+	Emptying the pool only rewinds to the first chunk, so after the first few blocks have
+	been run the same chunks are reused over and over, and no strings are ever malloc'd or
+	freed individually.
+
+	Strings bigger than a chunk get their own oversized chunk, which is kept in the chain
+	and reused like any other.
+**/
+
+#define CHUNK_SIZE 16384
+
+struct Chunk {
+	struct Chunk *next;
+	size_t size; // number of bytes in data
+	char data[];
 };
-static struct Link *listHead = NULL;
 
-/* allocates a string that doesn't make the caller responsible for freeing it, it's pointer is recorded and is freed automatically */
-char* strpool_alloc(const size_t length) {
-	struct Link *previousItem = listHead;
-	/*puts("---->");
-	previousItem = listHead;
-	while(previousItem != NULL) {
-		printf("\t%p %p  \"%s\"\n", previousItem, previousItem->str, previousItem->str);
-		previousItem = previousItem->next;
-	}
-	puts("\t----");
-	previousItem = listHead;*/
+static struct Chunk *firstChunk = NULL, *currentChunk = NULL;
+static char *top = NULL, *limit = NULL; // next free byte and end of the current chunk
+static size_t usedBefore = 0; // bytes used by chunks before the current one since the last reset
+static size_t highWaterMark = 0;
 
-	if(listHead == NULL) {
-		listHead = malloc(sizeof(struct Link));
-		listHead->next = NULL;
-	}
-	else {
-		listHead = malloc(sizeof(struct Link));
-		listHead->next = previousItem;
-	}
-	if(listHead == NULL) {
-		puts("[ERROR]Could not allocate link in strpool.");
+static struct Chunk* newChunk(const size_t size) {
+	struct Chunk *const chunk = malloc(sizeof(struct Chunk) + size*sizeof(char));
+	if(chunk == NULL)
 		return NULL;
+	chunk->next = NULL;
+	chunk->size = size;
+	return chunk;
+}
+
+static inline void useChunk(struct Chunk *const chunk) {
+	currentChunk = chunk;
+	top = chunk->data;
+	limit = chunk->data + chunk->size;
+}
+
+/* moves on to a chunk with room for at least length bytes, adding one to the chain if needed */
+static bool nextChunk(const size_t length) {
+	if(currentChunk == NULL) {
+		firstChunk = newChunk(length > CHUNK_SIZE ? length : CHUNK_SIZE);
+		if(firstChunk == NULL)
+			return false;
+		useChunk(firstChunk);
+		return true;
 	}
 
-	listHead->str = malloc(length*sizeof(char));
-	if(listHead->str == NULL)
-		puts("[ERROR]Could not allocate string in strpool.");
+	usedBefore += top - currentChunk->data;
+	struct Chunk *next = currentChunk->next;
+	if(next == NULL || next->size < length) { // insert a new chunk rather than throw away the rest of the chain
+		struct Chunk *const chunk = newChunk(length > CHUNK_SIZE ? length : CHUNK_SIZE);
+		if(chunk == NULL)
+			return false;
+		chunk->next = next;
+		currentChunk->next = chunk;
+		next = chunk;
+	}
+	useChunk(next);
+	return true;
+}
 
-	/*previousItem = listHead;
-	printf("\t%p %p  <no string>\n", previousItem, previousItem->str);
-	previousItem = listHead->next;
-	while(previousItem != NULL) {
-		printf("\t%p %p  \"%s\"\n", previousItem, previousItem->str, previousItem->str);
-		previousItem = previousItem->next;
+/* allocates a string that doesn't make the caller responsible for freeing it, it is freed automatically when the pool is emptied */
+char* strpool_alloc(const size_t length) {
+	if((size_t)(limit - top) < length) {
+		if(!nextChunk(length)) {
+			puts("[ERROR]Could not allocate chunk in strpool.");
+			return NULL;
+		}
 	}
-	puts("<----");*/
-	//printf("ALLOC: %p %p\n", listHead, listHead->str); // used in manually verifying that the right amount of frees was being done
-	
-	return listHead->str;
+	char *const str = top;
+	top += length;
+	return str;
 }
 
-/* frees all strings that have been allocated with allocString */
+/* frees all strings that have been allocated with strpool_alloc */
 void strpool_empty(void) {
-	struct Link *next, *current = listHead;
+	if(currentChunk == NULL)
+		return;
+	const size_t used = usedBefore + (top - currentChunk->data);
+	if(used > highWaterMark)
+		highWaterMark = used;
+	usedBefore = 0;
+	useChunk(firstChunk);
+}
+
+/* returns the most bytes that were ever in use in the pool at once, as of the last time it was emptied */
+size_t strpool_highWaterMark(void) {
+	return highWaterMark;
+}
+
+/* frees the chunks of the pool themselves */
+void strpool_free(void) {
+	struct Chunk *next, *current = firstChunk;
 	while(current != NULL) {
 		next = current->next;
-		//printf("FREE:  %p %p\n", current, current->str);
-		free(current->str);
 		free(current);
 		current = next;
 	}
-	listHead = NULL;
+	firstChunk = currentChunk = NULL;
+	top = limit = NULL;
+	usedBefore = 0;
 }
@@ -4,3 +4,5 @@ extern char* extractString(const char *const src, size_t *const len);
 
 extern char* strpool_alloc(const size_t length);
 extern void strpool_empty(void);
+extern size_t strpool_highWaterMark(void);
+extern void strpool_free(void);
@@ -23,6 +23,7 @@
 
 void threadContext_init(ThreadContext *const context, const struct Block *const topBlock) {
 	context->topBlock = topBlock;
+	context->cold = false;
 	dynarray_init(&context->stack, sizeof(Value));
 	dynarray_init(&context->blockStack, sizeof(struct BlockStackFrame));
 	dynarray_init(&context->tmp, sizeof(Value));
@@ -30,6 +31,15 @@ void threadContext_init(ThreadContext *const context, const struct Block *const
 	dynarray_init(&context->nParametersStack, sizeof(uint16));
 }
 
+/* Sets up a context without initializing it, for a thread that might never be started. It
+	 counts as stopped, and has to be initialized with threadContext_init before it is
+	 started. */
+void threadContext_initCold(ThreadContext *const context, const struct Block *const topBlock) {
+	context->topBlock = topBlock;
+	context->frame.nextBlock = NULL;
+	context->cold = true;
+}
+
 void threadContext_done(ThreadContext *const context) {
 	dynarray_done(&context->stack);
 	dynarray_done(&context->blockStack);
@@ -99,18 +109,3 @@ void threadList_remove(ThreadList **const head, ThreadList *const element) {
 		element->next->prev = element->prev;
 }
 
-void threadList_copyArray(ThreadList *const newList, const ThreadList *const oldList, ThreadLink *const newThreads, const ThreadLink *const oldThreads) {
-	if(newList->nThreads != 0) {
-		newList->array = malloc(newList->nThreads*sizeof(ThreadLink*));
-		for(uint16 i = 0; i < newList->nThreads; ++i) {
-			newList->array[i] = newThreads + (long)(oldList->array[i] - oldThreads);
-		}
-	}
-}
-
-ThreadList* threadList_copy(ThreadList *const oldList, ThreadLink *const newThreads, const ThreadLink *const oldThreads) {
-	ThreadList *new = malloc(sizeof(ThreadList));
-	new->nThreads = oldList->nThreads;
-	threadList_copyArray(new, oldList, newThreads, oldThreads);
-	return new;
-}
@@ -3,6 +3,7 @@
 #include "types/thread.h"
 
 extern void threadContext_init(ThreadContext *const context, const struct Block *const topBlock);
+extern void threadContext_initCold(ThreadContext *const context, const struct Block *const topBlock);
 extern void threadContext_done(ThreadContext *const context);
 extern void threadContext_reset(ThreadContext *const context);
 
@@ -21,8 +22,6 @@ extern void threadList_insert(ThreadList *const existingElement, ThreadList *con
 /* pass NULL for `head` if you don't know what the head is, but you do know that `element` is not the head */
 extern void threadList_remove(ThreadList **const head, ThreadList *const element);
 
-extern void threadList_copyArray(ThreadList *const newList, const ThreadList *const oldList, ThreadLink *const newThreads, const ThreadLink *const oldThreads);
-extern ThreadList* threadList_copy(ThreadList *const oldList, ThreadLink *const newThreads, const ThreadLink *const oldThreads);
 
 #define THREADLINK_FOR_EACH(/* ThreadLink *threadLink, ThreadLink *next, ThreadLink stubLink */ threadLink, stubLink) \
 	for((threadLink) = (stubLink).next; (threadLink) != NULL; (threadLink) = (threadLink)->next)
@@ -11,6 +11,7 @@ struct Block {
 		struct Block *next; // if this is a stack block, this links to the next Block, NULL if it is the end of the stack
 		const struct Value *value; // if this is a constant argument, this is a pointer to the Value of this argument
 		struct Block **substacks; // if this is a control flow block (e.g. if/else), then this points to an array of pointers to possible substacks to jump to
+		uint16 nArgs; // if this is a reporter that takes any number of arguments (e.g. a flattened join), this is how many it has
 	} p;
 };
 typedef struct Block Block;
@@ -2,8 +2,9 @@
 	Costumes
 
 	The runtime stores costumes in memory as either an uncompressed bitmap or vertex data
-	that can be passed to OpenGL with the right shader to render the costume. PNGs are
-	decompressed at load time before passing them to the runtime.
+	that can be passed to OpenGL with the right shader to render the costume. A costume only
+	names the resource its image is in, and the image is decoded the first time the costume
+	is used rather than at load time (see zip_loader.c).
 
 	Although SVGs aren't implemented yet, the plan is to parse the SVG, using NanoSVG or
 	similar tools, into a set of vertex data, and render the vertex data using a shader on
@@ -17,8 +18,7 @@
 **/
 
 struct Costume {
-	bool isTexture; // true if this costume is already stored on the GPU as a texture
-	GLuint textureHandle;
+	uint32 resource; // index of the resource of the costume's image
 	GLuint vaoHandle;
 	//uint16 i; // index of costume can be calculated
 	const char *name;
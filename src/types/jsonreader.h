@@ -0,0 +1,21 @@
+#pragma once
+
+/* The kinds of token a JsonReader stops on. Everything after JSON_END is a value, so going
+	 through the values of an array, or the keys and values of an object, is a loop that runs
+	 while the reader gives something greater than JSON_END. */
+enum JsonToken {
+	JSON_ERROR, // the input ended, or ended in the middle of a string
+	JSON_END, // the closing bracket of an object or array
+	JSON_OBJECT,
+	JSON_ARRAY,
+	JSON_STRING, // the token is what is between the quotes, with escapes left in
+	JSON_PRIMITIVE // a number, true, false or null
+};
+
+struct JsonReader {
+	const char *pos, *end; // what is left of the input
+	enum JsonToken type; // the token the reader is on
+	const char *start; // where the token starts in the input
+	size_t len;
+};
+typedef struct JsonReader JsonReader;
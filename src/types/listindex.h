@@ -0,0 +1,17 @@
+#pragma once
+
+/* An item of a ListIndex. A count of 0 means the entry is empty. */
+struct ListIndexEntry {
+	uint64_t hash;
+	Value key; // owns its string, if it is one
+	uint32 count; // number of items in the list equal to key
+};
+
+/* A hash table counting the items of a list, so that "list contains" doesn't need to go
+	 through the whole list. */
+struct ListIndex {
+	struct ListIndexEntry *entries;
+	uint32 mask; // number of entries - 1, which is always a power of two minus one
+	uint32 nKeys; // number of entries that aren't empty
+};
+typedef struct ListIndex ListIndex;
@@ -13,8 +13,21 @@
 	Only the Stage and parent sprites get a unique `name` and `procedureHashTable`, and it
 	is freed with the sprite. Clones simply share the same name as their parent, and must
 	not free `name` or `procedureHashTable`.
+
+	Clones are kept in the `clonePool` of the sprite they are a clone of, and are reused by
+	its next clone when they are deleted. Clones don't get their own ThreadLists, and use the
+	`whenClonedThreads` and `broadcastThreadLists` of the sprite instead (see the Clones
+	section of runtime.c).
 **/
 
+/* The clones of a sprite, shared by the sprite and all of its clones. */
+struct ClonePool {
+	struct SpriteContext *sprite; // the sprite the clones are of
+	struct CloneRecord *live; // linked list of the clones, newest first
+	struct CloneRecord *free; // linked list of deleted clones that can be reused
+	size_t recordSize; // size of a clone and its threads
+};
+
 enum SpriteScope {
 	STAGE,
 	SPRITE,
@@ -27,14 +40,16 @@ struct SpriteContext {
 
 	struct ThreadLink *threads; // array of thread contexts
 	uint16 nThreads;
+	struct ThreadLink *runningThreads; // linked list of the sprite's threads that are running
 
-	struct Variable *variables; // a hash table of Scratch variables
+	struct Variables variables; // Scratch variables, by slot
 	struct List *lists; // a hash table of Scratch lists
 
 	struct ProcedureLink *procedureHashTable; // table of pointers to procedures to be accessed with hashes
 	struct ThreadList whenClonedThreads; // TODO: don't need a  ThreadList for this
 	struct ThreadList **broadcastThreadLists; // array of pointers to ThreadLists for broadcast threads
 	uint16 nBroadcastThreadLists;
+	struct ClonePool *clonePool; // NULL until the sprite makes its first clone
 
 	double xpos, ypos, direction, size;
 	struct {
@@ -43,8 +58,9 @@ struct SpriteContext {
 			fisheye, whirl;
 	} effects;
 
-	const struct Costume *costumes;
-	const struct Costume *currentCostume;
+	struct Costume *costumes; // array of the sprite's costumes, which is also a hash table of them by name
+	uint16 nCostumes;
+	uint16 currentCostume; // index into costumes
 };
 typedef struct SpriteContext SpriteContext;
 
@@ -17,6 +17,7 @@ struct ThreadContext {
 	dynarray blockStack; // dynarray of BlockStackFrames
 
 	clock_t lastTime;
+	bool cold; // if it hasn't been initialized, because it hasn't been started yet
 
 	dynarray tmp; // dynarray of struct TmpDatas
 
@@ -32,6 +33,7 @@ struct ThreadLink {
 	struct ThreadContext thread;
 	struct SpriteContext *sprite;
 	struct ThreadLink *next, *prev;
+	struct ThreadLink *nextInSprite, *prevInSprite; // list of the running threads of the sprite
 };
 typedef struct ThreadLink ThreadLink;
 
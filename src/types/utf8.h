@@ -0,0 +1,12 @@
+#pragma once
+
+#define UTF8_INDEX_STRIDE 32 // characters between each byte offset recorded in a Utf8Index
+
+/* An index of the characters in a UTF-8 string, so that finding the nth character doesn't
+	 need to go through every character before it. */
+struct Utf8Index {
+	size_t nBytes, nChars;
+	bool isAscii; // if true, every character is one byte and there are no offsets
+	uint32 *offsets; // byte offset of every UTF8_INDEX_STRIDE'th character
+};
+typedef struct Utf8Index Utf8Index;
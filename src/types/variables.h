@@ -2,15 +2,67 @@
 
 #include "../ut/uthash.h" // don't worry about unused functionality, it is all macros, so it only affects the pre-processing stage
 
-struct Variable {
-	struct Value value;
+/* A string stored in a variable. Clones share the strings of the sprite they were cloned
+	 from, so they are reference counted, and are only changed when they aren't shared. */
+struct VariableString {
+	uint32 refCount;
+	size_t length, capacity; // capacity is the number of characters that fit, not counting the terminator
+	struct Utf8Index *index; // index of the characters, built when it is first needed by a string block
+	char data[];
+};
+
+struct VariableSymbol {
 	const char *name;
+	uint16 slot; // position of the variable's value in the values of a sprite
 	UT_hash_handle hh;
 };
-typedef struct Variable Variable;
+
+/* The names of a sprite's variables. This is shared by the sprite and its clones. */
+struct SymbolTable {
+	struct VariableSymbol *names; // hash table of names
+	uint16 nSymbols;
+};
+
+/* The variables of a sprite, stored by slot. A string in values is always the data of a
+	 VariableString. */
+struct Variables {
+	Value *values;
+	uint16 nValues; // can be less than the number of symbols if variables were added after the values were made
+	uint16 capacity; // number of Values values has room for
+	struct SymbolTable *symbols;
+};
+typedef struct Variables Variables;
+
+enum ListStorage {
+	LIST_FLOATING, // every item is a number, and items is an array of doubles
+	LIST_STRING, // every item is a string, and items is an array of char*
+	LIST_GENERIC // items is an array of Values
+};
+
+/* the list as a string, as the list reporter shows it */
+struct ListContents {
+	char *string;
+	size_t length, capacity;
+	size_t nChars; // total characters of the items, which is used to decide if they are joined with spaces
+	bool valid; // if false, string needs to be rebuilt before it is used
+};
+
+/* The buffer of the items of a list. It is shared by a list and its copies in clones until
+	 one of them changes. */
+struct ListItems {
+	uint32 refCount; // number of lists sharing this
+	double data[]; // the items, stored as described by enum ListStorage (double is just for alignment)
+};
 
 struct List {
-	UT_array contents; // dynamic array of Values
+	struct ListItems *items; // ring buffer of the items, see the Lists section of variables.c
+	uint32 head; // position of the first item in items
+	uint32 length, capacity; // capacity is 0 or a power of two
+	ubyte storage; // enum ListStorage, for how items are stored
+	struct ListIndex *index; // index of the items for "contains", if it has been searched enough to have one
+	uint32 nScans; // times "contains" has gone through the list without an index
+	uint32 nUpdates; // changes to the index since it was last used
+	struct ListContents contents;
 	const char *name;
 	UT_hash_handle hh;
 };
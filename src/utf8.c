@@ -0,0 +1,158 @@
+/**
+	UTF-8
+	  utf8.c
+
+	Helpers for the string blocks, which count and index strings by character rather than
+	by byte. All strings in a project are UTF-8, but most of them are plain ASCII, so the
+	first thing done with a string is always a check for whether or not it is all ASCII, in
+	which case characters are just bytes.
+
+	For other strings, a character is found by going through the string from the start, so
+	when the same string will be indexed many times (e.g. a script looping through every
+	letter of a variable), a Utf8Index can be built once. It records the byte offset of
+	every UTF8_INDEX_STRIDE'th character, so finding any character only needs to go through
+	at most UTF8_INDEX_STRIDE-1 others.
+
+	Malformed UTF-8 is not rejected, because there is nothing sensible for a block to do
+	about it. Every byte that isn't a continuation byte starts a new character, and no
+	function here ever reads past the length it is given.
+
+	The ASCII check and character count use SSE2 when it is available, and otherwise fall
+	back to checking a word at a time.
+**/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "types/primitives.h"
+
+#include "utf8.h"
+
+#define isContinuation(c) (((c) & 0xC0) == 0x80)
+
+/* Returns true if none of the len bytes at str are above 0x7F. */
+bool utf8_isAscii(const char *const str, const size_t len) {
+	size_t i = 0;
+#ifdef __SSE2__
+	__m128i acc = _mm_setzero_si128();
+	for(; i + 16 <= len; i += 16)
+		acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i*)(str+i)));
+	if(_mm_movemask_epi8(acc) != 0)
+		return false;
+#else
+	uint64_t acc = 0, word;
+	for(; i + 8 <= len; i += 8) {
+		memcpy(&word, str+i, 8);
+		acc |= word;
+	}
+	if(acc & UINT64_C(0x8080808080808080))
+		return false;
+#endif
+	for(; i < len; ++i) {
+		if(str[i] & 0x80)
+			return false;
+	}
+	return true;
+}
+
+/* Returns the number of characters in the len bytes at str. */
+size_t utf8_count(const char *const str, const size_t len) {
+	if(len == 0)
+		return 0;
+	size_t count = 0, i = 0;
+#ifdef __SSE2__
+	const __m128i lastContinuation = _mm_set1_epi8(-65); // continuation bytes (0x80-0xBF) are -128 to -65 as signed bytes
+	for(; i + 16 <= len; i += 16) {
+		const __m128i notContinuation = _mm_cmpgt_epi8(_mm_loadu_si128((const __m128i*)(str+i)), lastContinuation);
+		count += __builtin_popcount(_mm_movemask_epi8(notContinuation));
+	}
+#endif
+	for(; i < len; ++i)
+		count += !isContinuation(str[i]);
+	return count + isContinuation(str[0]); // a string starting with a stray continuation byte still starts with a character
+}
+
+/* returns a pointer to the start of the character after the one at str */
+static inline const char* nextChar(const char *str, const char *const end) {
+	do ++str; while(str != end && isContinuation(*str));
+	return str;
+}
+
+/* Finds the i'th (from 0) character in the len bytes at str without an index. Points ch to
+	 the character and returns its length in bytes, or returns 0 if there is no i'th character. */
+size_t utf8_charAt(const char *const str, const size_t len, const size_t i, const char **const ch) {
+	if(utf8_isAscii(str, len)) {
+		if(i >= len)
+			return 0;
+		*ch = str+i;
+		return 1;
+	}
+	const char *p = str, *const end = str+len;
+	for(size_t n = i; n != 0 && p != end; --n)
+		p = nextChar(p, end);
+	if(p == end)
+		return 0;
+	*ch = p;
+	return nextChar(p, end) - p;
+}
+
+void utf8Index_build(Utf8Index *const index, const char *const str, const size_t len) {
+	index->nBytes = len;
+	index->offsets = NULL;
+	if(utf8_isAscii(str, len)) {
+		index->isAscii = true;
+		index->nChars = len;
+		return;
+	}
+
+	index->isAscii = false;
+	index->nChars = utf8_count(str, len);
+	index->offsets = malloc((index->nChars/UTF8_INDEX_STRIDE + 1)*sizeof(uint32));
+	if(index->offsets == NULL) {
+		puts("[ERROR]Could not allocate UTF-8 index.");
+		index->nChars = 0;
+		return;
+	}
+
+	const char *p = str, *const end = str+len;
+	for(size_t n = 0; p != end; ++n) {
+		if(n % UTF8_INDEX_STRIDE == 0)
+			index->offsets[n/UTF8_INDEX_STRIDE] = p - str;
+		p = nextChar(p, end);
+	}
+}
+
+/* Updates an index for len bytes of ASCII being appended to its string. Returns false if
+	 the index can't be updated and needs to be rebuilt. */
+bool utf8Index_appendAscii(Utf8Index *const index, const char *const str, const size_t len) {
+	if(!index->isAscii || !utf8_isAscii(str, len))
+		return false;
+	index->nBytes += len;
+	index->nChars += len;
+	return true;
+}
+
+void utf8Index_done(Utf8Index *const index) {
+	free(index->offsets);
+	index->offsets = NULL;
+}
+
+/* Same as utf8_charAt, but uses an index of str. */
+size_t utf8Index_charAt(const Utf8Index *const index, const char *const str, const size_t i, const char **const ch) {
+	if(i >= index->nChars)
+		return 0;
+	if(index->isAscii) {
+		*ch = str+i;
+		return 1;
+	}
+	const char *p = str + index->offsets[i/UTF8_INDEX_STRIDE], *const end = str + index->nBytes;
+	for(size_t n = i % UTF8_INDEX_STRIDE; n != 0; --n)
+		p = nextChar(p, end);
+	*ch = p;
+	return nextChar(p, end) - p;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "types/utf8.h"
+
+extern bool utf8_isAscii(const char *const str, const size_t len);
+extern size_t utf8_count(const char *const str, const size_t len);
+extern size_t utf8_charAt(const char *const str, const size_t len, const size_t i, const char **const ch);
+
+extern void utf8Index_build(Utf8Index *const index, const char *const str, const size_t len);
+extern bool utf8Index_appendAscii(Utf8Index *const index, const char *const str, const size_t len);
+extern void utf8Index_done(Utf8Index *const index);
+extern size_t utf8Index_charAt(const Utf8Index *const index, const char *const str, const size_t i, const char **const ch);
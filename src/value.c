@@ -6,6 +6,7 @@
 #include "types/value.h"
 
 #include "strpool.h"
+#include "numparse.h"
 
 #include "value.h"
 
@@ -54,22 +55,21 @@ static bool strnTryToBoolean(const char *str, const size_t len, bool *ret) {
 }
 
 /* Tries to convert the given string to a double, and stores the resulting double in ret. Returns true if successful, false otherwise. */
-static bool strTryToFloating(const char *str, double *ret) {
-	char *endptr;
-	*ret = strtod(str, &endptr); // do a conversion to a number
-	if(endptr - str != strlen(str)) // if data was lost
-		return false;
-	else
-		return true;
+static inline bool strTryToFloating(const char *str, double *ret) {
+	return strnToFloating(str, strlen(str), ret);
 }
 
-static bool strnTryToFloating(const char *str, const size_t len, double *ret) {
-	char *endptr;
-	*ret = strtod(str, &endptr); // do a conversion to a number
-	if(endptr - str != len) // if data was lost
-		return false;
+static inline bool strnTryToFloating(const char *str, const size_t len, double *ret) {
+	return strnToFloating(str, len, ret);
+}
+
+/* Converts the given string to a double, defaulting to 0 if it isn't a number like Scratch does. */
+static double strToFloating(const char *str) {
+	double r;
+	if(strTryToFloating(str, &r))
+		return r;
 	else
-		return true;
+		return 0.0;
 }
 
 static union {
@@ -117,7 +117,7 @@ int64 toInteger(const Value *const value) {
 		if(strTryToBoolean(value->data.string, &t.b))
 			return t.b;
 		else
-			return (int64)strtoll(value->data.string, NULL, 0);
+			return (int64)strToFloating(value->data.string);
 
 	case BOOLEAN:
 		return value->data.boolean;
@@ -137,25 +137,29 @@ double toFloating(const Value *const value) {
 		if(strTryToBoolean(value->data.string, &t.b))
 			return t.b;
 		else
-			return strtod(value->data.string, NULL);
+			return strToFloating(value->data.string);
 
 	case BOOLEAN:
 		return (double)value->data.boolean;
 	}
 }
 
+/* formats a double into a string allocated with strpool_alloc, and returns the length of the string */
+static size_t floatingToString(const double floating, char **string) {
+	static char buf[64];
+	const size_t size = sprintf(buf, "%g", floating)+1;
+	*string = strpool_alloc(size);
+	memcpy(*string, buf, size);
+	return size-1;
+}
+
 /* takes a Value, creates a string with strpool_alloc(will be auto freed), and return the length of the string */
 size_t toString(const Value *const value, char **string) {
 	size_t size;
-	static char buf[64];
 	switch(value->type) {
 
 	case FLOATING:
-		sprintf(buf, "%g", value->data.floating);
-		size = strlen(buf)+1;
-		*string = strpool_alloc(size);
-		memcpy(*string, buf, size);
-		return size-1;
+		return floatingToString(value->data.floating, string);
 
 	case STRING:
 		size = strlen(value->data.string)+1;
@@ -177,6 +181,33 @@ size_t toString(const Value *const value, char **string) {
 	}
 }
 
+/* Like toString, but borrows the Value's string rather than copying it when there is one,
+   and never allocates for booleans. The string must not be modified, and it is only valid
+   for as long as the Value's string is and until the pool is emptied. */
+size_t toStringView(const Value *const value, const char **string) {
+	switch(value->type) {
+
+	case FLOATING:
+		return floatingToString(value->data.floating, (char**)string);
+
+	case STRING:
+		*string = value->data.string;
+		return strlen(value->data.string);
+
+	case BOOLEAN:
+		if(value->data.boolean) {
+			*string = "true";
+			return 4;
+		}
+		else {
+			*string = "false";
+			return 5;
+		}
+	}
+	*string = "";
+	return 0;
+}
+
 bool toBoolean(const Value *const value) {
 	switch(value->type) {
 	case FLOATING:
@@ -186,7 +217,7 @@ bool toBoolean(const Value *const value) {
 		if(strTryToBoolean(value->data.string, &t.b))
 			return t.b;
 		else
-			return strtoll(value->data.string, NULL, 0) == 1;
+			return strToFloating(value->data.string) == 1.0;
 
 	case BOOLEAN:
 		return value->data.boolean;
@@ -228,20 +259,28 @@ Value extractValue(const Value *const value) {
 		return *value;
 }
 
+/* Tries to simplify a string to a primitive. Returns true and stores the primitive in
+	 simplified if it can be. */
+bool trySimplifyString(const char *const string, Value *const simplified) {
+	if(strTryToFloating(string, &t.f)) {
+		simplified->type = FLOATING;
+		simplified->data.floating = t.f;
+	}
+	else if(strTryToBoolean(string, &t.b)) {
+		simplified->type = BOOLEAN;
+		simplified->data.boolean = t.b;
+	}
+	else
+		return false;
+	return true;
+}
+
 /* Returns a new Value form the given Value, and simplifies a string, if any,
 	 if possible, to a primitive. */
 Value extractSimplifiedValue(const Value *const value) {
 	if(value->type == STRING) {
 		Value copy;
-		if(strTryToFloating(value->data.string, &t.f)) {
-			copy.type = FLOATING;
-			copy.data.floating = t.f;
-		}
-		else if(strTryToBoolean(value->data.string, &t.b)) {
-			copy.type = BOOLEAN;
-			copy.data.boolean = t.b;
-		}
-		else {
+		if(!trySimplifyString(value->data.string, &copy)) {
 			copy.type = STRING;
 			copy.data.string = extractString(value->data.string, NULL);
 		}
@@ -9,10 +9,12 @@ extern bool tryToFloating(const Value *const value, double *ret);
 extern int64 toInteger(const Value *const value);
 extern double toFloating(const Value *const value);
 extern size_t toString(const Value *const value, char **string);
+extern size_t toStringView(const Value *const value, const char **string);
 extern bool toBoolean(const Value *const value);
 
 // parsing
 extern Value strnToValue(const char *const string, const size_t length);
+extern bool trySimplifyString(const char *const string, Value *const simplified);
 
 // copying
 extern Value extractValue(const Value *const value);
@@ -3,13 +3,15 @@
 	  variables.c
 
 	This module handles the variables and lists in a Scratch project, and provides an
-	interface for interacting with the data. Variables and lists are accessed by name
-	through a hash table. The hash tables are implemented by Troy D. Hanson, and the
+	interface for interacting with the data. Lists, and the names of variables, are found
+	through hash tables. The hash tables are implemented by Troy D. Hanson, and the
 	implementation can be found in ut/uthash.h.
 
-	Variables are stored by the Variable structure, which contains their value and the
-	metadata that is part of the hash table. Lists are stored in the List structure, which
-	also contains metadata, and the contents are stored as a dynarray of Values.
+	Variables are stored in an array of Values for each sprite, and the hash table of their
+	names, the symbol table, gives where in the array each one is (see the Variables
+	section). Lists are stored in the List structure, which also contains metadata, and the
+	items are stored in a ring buffer, either as a column of numbers, a column of strings, or
+	an array of Values (see the Lists section).
 
 	Interface
 
@@ -24,17 +26,25 @@
 **/
 
 #include <stdio.h>
+#include <stddef.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "types/primitives.h"
 
 #include "ut/uthash.h"
-#include "ut/utarray.h"
 
 #include "types/value.h"
 #include "types/variables.h"
 
 #include "value.h"
 #include "variables.h"
+#include "utf8.h"
+#include "listindex.h"
 
 #include "strpool.h"
 
@@ -58,95 +68,701 @@ static void value_dtor(Value *v) {
 
 /** Variables **/
 
-/* Takes an already allocated Variable, initializes it, and adds it to the given hash table of Variables. */
-void variable_init(Variable **variables, Variable *const variable, const char *const name, const size_t nameLen, const Value *const value) {
-	variable->name = extractString(name, (size_t*)&nameLen);
-	if(value == NULL)
-		variable->value = defaultValue;
-	else
-		variable->value = extractSimplifiedValue(value);
-	HASH_ADD_KEYPTR(hh, *variables, variable->name, nameLen, variable);
+/*
+	The variables of a sprite are an array of Values, and a variable is found in it by its
+	slot. The slots of a sprite's variables are kept in a symbol table of their names, which
+	is shared by the sprite and its clones, so a clone's variables are just a copy of the
+	array. Blocks that name a variable with a constant get its slot when the project is loaded
+	(see resolveVariables in project_loader.c), so only blocks with names that are worked out
+	while running need to look up names in the symbol table.
+
+	Strings in variables are VariableStrings, which are reference counted so that a clone can
+	share the strings of the sprite it is cloned from. A VariableString is never changed while
+	it is shared.
+*/
+
+#define variableString(str) ((struct VariableString*)((str) - offsetof(struct VariableString, data)))
+
+/* Makes a string for a variable with room for capacity characters plus a terminator, and
+	 copies len characters of str into it. Returns NULL if it couldn't be allocated. */
+static char* newVariableString(const char *const str, const size_t len, const size_t capacity) {
+	struct VariableString *const vs = malloc(sizeof(struct VariableString) + capacity + 1);
+	if(vs == NULL) {
+		puts("[ERROR]Could not allocate string for variable.");
+		return NULL;
+	}
+	vs->refCount = 1;
+	vs->length = len;
+	vs->capacity = capacity;
+	vs->index = NULL;
+	memcpy(vs->data, str, len);
+	vs->data[len] = '\0';
+	return vs->data;
 }
 
-/* Same as variable_add except it allocates the new variable */
-void variable_new(Variable **variables, const char *const name, const size_t nameLen, const Value *const value) {
-	Variable *const newVar = malloc(sizeof(Variable));
-	if(newVar == NULL) {
-		printf("[ERROR]Could not allocate new variable \"%s\"\n", name);
-		return;
+/* frees the index of the characters in a variable's string */
+static void dropUtf8Index(struct VariableString *const vs) {
+	if(vs->index != NULL) {
+		utf8Index_done(vs->index);
+		free(vs->index);
+		vs->index = NULL;
 	}
-	variable_init(variables, malloc(sizeof(Variable)), name, nameLen, value);
 }
 
-void freeVariables(Variable **variables) {
-	Variable *current, *tmp;
-	HASH_ITER(hh, *variables, current, tmp) {
-		HASH_DEL(*variables, current);
-		value_dtor(&current->value);
-		free(current);
+static inline void retainValue(const Value *const value) {
+	if(value->type == STRING)
+		++variableString(value->data.string)->refCount;
+}
+
+static inline void releaseValue(const Value *const value) {
+	if(value->type == STRING) {
+		struct VariableString *const vs = variableString(value->data.string);
+		if(--vs->refCount == 0) {
+			dropUtf8Index(vs);
+			free(vs);
+		}
 	}
 }
 
-Variable* copyVariables(const Variable *const *const variables) {
-	Variable *newVars = NULL;
-	const Variable *src = *variables;
-	for(uint16 i = HASH_COUNT(*variables); i != 0; --i) {
-		Variable *new = malloc(sizeof(Variable));
-		size_t len = 0;
-		new->name = extractString(src->name, &len);
-		new->value = extractValue(&src->value);
-		HASH_ADD_KEYPTR(hh, newVars, new->name, len, new);
-		src = src->hh.next;
+/* Makes a Value that can be stored in a variable from any other Value. */
+static Value variableValue(const Value *const value) {
+	Value r;
+	if(value->type != STRING || trySimplifyString(value->data.string, &r))
+		return value->type != STRING ? *value : r;
+	const size_t len = strlen(value->data.string);
+	r.data.string = newVariableString(value->data.string, len, len);
+	if(r.data.string == NULL)
+		return defaultValue;
+	r.type = STRING;
+	return r;
+}
+
+/* Gets the Value in a slot, making room for it if a new variable was added to the symbol
+	 table since the sprite's values were made. Returns NULL if there wasn't room, or if the
+	 slot is NO_VARIABLE. */
+static Value* slotValue(Variables *const variables, const uint16 slot) {
+	if(slot < variables->nValues)
+		return variables->values+slot;
+	if(slot == NO_VARIABLE)
+		return NULL;
+	if(slot >= variables->capacity) {
+		Value *const values = realloc(variables->values, (slot+1)*sizeof(Value));
+		if(values == NULL) {
+			puts("[ERROR]Could not grow variables.");
+			return NULL;
+		}
+		variables->values = values;
+		variables->capacity = slot+1;
+	}
+	for(uint16 i = variables->nValues; i <= slot; ++i)
+		variables->values[i] = defaultValue;
+	variables->nValues = slot+1;
+	return variables->values+slot;
+}
+
+/* Makes a sprite's variables, with a new empty symbol table. */
+void variables_init(Variables *const variables) {
+	variables->values = NULL;
+	variables->nValues = variables->capacity = 0;
+	variables->symbols = malloc(sizeof(struct SymbolTable));
+	if(variables->symbols == NULL) {
+		puts("[ERROR]Could not allocate symbol table.");
+		return;
 	}
-	return newVars;
+	variables->symbols->names = NULL;
+	variables->symbols->nSymbols = 0;
 }
 
-/* returns true if the variable does not exist in the hash table */
-bool setVariable(Variable **variables, const char *const name, const Value *const newValue) {
-	Variable *var;
-	HASH_FIND_STR(*variables, name, var);
-	if(var == NULL)
+/* Frees the values of a sprite's variables. The symbol table is shared with the sprite's
+	 clones, so it isn't freed. */
+void variables_free(Variables *const variables) {
+	variables_clear(variables);
+	free(variables->values);
+	variables->values = NULL;
+	variables->capacity = 0;
+}
+
+/* Lets go of the values of a sprite's variables, but keeps the array they were in, so a
+	 clone that is being reused can copy new values into it. */
+void variables_clear(Variables *const variables) {
+	for(uint16 i = 0; i < variables->nValues; ++i)
+		releaseValue(variables->values+i);
+	variables->nValues = 0;
+}
+
+/* Copies the variables of a sprite for a clone of it. dst must have no values, either
+	 because its values array is NULL with no capacity, or because it was cleared, in which
+	 case the array is reused if it is big enough. */
+void variables_copy(Variables *const dst, const Variables *const src) {
+	dst->symbols = src->symbols;
+	dst->nValues = 0;
+	if(src->nValues == 0)
+		return;
+	if(dst->capacity < src->nValues) {
+		free(dst->values);
+		dst->capacity = 0;
+		dst->values = malloc(src->nValues*sizeof(Value));
+		if(dst->values == NULL) {
+			puts("[ERROR]Could not copy variables.");
+			return;
+		}
+		dst->capacity = src->nValues;
+	}
+	dst->nValues = src->nValues;
+	memcpy(dst->values, src->values, src->nValues*sizeof(Value));
+	for(uint16 i = 0; i < src->nValues; ++i)
+		retainValue(dst->values+i);
+}
+
+/* Finds the slot of a variable by its name. Returns true if the variable doesn't exist. */
+bool variables_find(const Variables *const variables, const char *const name, uint16 *const slot) {
+	struct VariableSymbol *symbol;
+	HASH_FIND_STR(variables->symbols->names, name, symbol);
+	if(symbol == NULL)
 		return true;
-	value_dtor(&var->value);
-	var->value = extractSimplifiedValue(newValue);
+	*slot = symbol->slot;
 	return false;
 }
 
-bool getVariable(Variable **variables, const char *const name, Value *const returnValue) {
-	Variable *var;
-	HASH_FIND_STR(*variables, name, var);
-	if(var == NULL) {
+/* Adds a new variable, which must not already exist, to a sprite's variables, and returns
+	 its slot. If value is NULL, the variable is set to the default Value. Returns NO_VARIABLE
+	 if it couldn't be added, which the variable accessors treat as an empty slot. */
+uint16 variable_new(Variables *const variables, const char *const name, size_t nameLen, const Value *const value) {
+	struct VariableSymbol *const symbol = variables->symbols->nSymbols == NO_VARIABLE ? NULL : malloc(sizeof(struct VariableSymbol));
+	if(symbol == NULL) {
+		printf("[ERROR]Could not allocate new variable \"%.*s\"\n", (int)nameLen, name);
+		return NO_VARIABLE;
+	}
+	symbol->name = extractString(name, &nameLen);
+	symbol->slot = variables->symbols->nSymbols++;
+	HASH_ADD_KEYPTR(hh, variables->symbols->names, symbol->name, nameLen, symbol);
+	Value *const slot = slotValue(variables, symbol->slot);
+	if(slot != NULL)
+		*slot = value == NULL ? defaultValue : variableValue(value);
+	return symbol->slot;
+}
+
+Value getVariableAt(Variables *const variables, const uint16 slot) {
+	return slot < variables->nValues ? variables->values[slot] : defaultValue;
+}
+
+void setVariableAt(Variables *const variables, const uint16 slot, const Value *const newValue) {
+	Value *const value = slotValue(variables, slot);
+	if(value == NULL)
+		return;
+	const Value old = *value;
+	*value = variableValue(newValue); // before releasing the old value, in case the new one is the same string
+	releaseValue(&old);
+}
+
+/* Appends the first len characters of str onto the variable's value, turning the value into
+	 a string first if it isn't one. The variable's string is over-allocated, so that building
+	 up a string by repeatedly appending to it takes linear rather than quadratic time. str is
+	 allowed to point into the variable's own string. The result is not simplified to a number
+	 like setVariable would, because that would mean re-reading the whole string every time. */
+void appendToVariableAt(Variables *const variables, const uint16 slot, const char *const str, const size_t len) {
+	Value *const value = slotValue(variables, slot);
+	if(value == NULL)
+		return;
+
+	if(value->type == STRING) {
+		struct VariableString *const vs = variableString(value->data.string);
+		if(vs->refCount == 1 && vs->length + len <= vs->capacity) { // if it can be appended to in place
+			if(vs->index != NULL && !utf8Index_appendAscii(vs->index, str, len))
+				dropUtf8Index(vs);
+			memmove(vs->data + vs->length, str, len); // str can't overlap where it is going, but it is allowed to be in the same string
+			vs->length += len;
+			vs->data[vs->length] = '\0';
+			return;
+		}
+	}
+
+	// make a new string with extra room, copy the current value into it, and then append
+	const char *current;
+	const size_t currentLen = value->type == STRING ? variableString(value->data.string)->length : toStringView(value, &current);
+	if(value->type == STRING)
+		current = value->data.string;
+	size_t capacity = currentLen*2;
+	if(capacity < currentLen + len)
+		capacity = currentLen + len;
+	char *const new = newVariableString(current, currentLen, capacity);
+	if(new == NULL)
+		return;
+	memcpy(new + currentLen, str, len);
+	new[currentLen + len] = '\0';
+	struct VariableString *const vs = variableString(new);
+	vs->length = currentLen + len;
+	if(value->type == STRING) { // keep the index if it is up to date and this was its only user
+		struct VariableString *const old = variableString(value->data.string);
+		if(old->refCount == 1 && old->index != NULL && utf8Index_appendAscii(old->index, str, len)) {
+			vs->index = old->index;
+			old->index = NULL;
+		}
+	}
+	releaseValue(value);
+	value->type = STRING;
+	value->data.string = new;
+}
+
+/* Same as getVariableAt, but if the variable's value is a string, also gives an index of
+	 the characters in it for the string blocks, building the index if it hasn't been already.
+	 *index is NULL if the value isn't a string. */
+Value getVariableUtf8IndexAt(Variables *const variables, const uint16 slot, const Utf8Index **const index) {
+	const Value value = getVariableAt(variables, slot);
+	*index = NULL;
+	if(value.type == STRING) {
+		struct VariableString *const vs = variableString(value.data.string);
+		if(vs->index == NULL) {
+			vs->index = malloc(sizeof(Utf8Index));
+			if(vs->index == NULL)
+				return value;
+			utf8Index_build(vs->index, vs->data, vs->length);
+		}
+		*index = vs->index;
+	}
+	return value;
+}
+
+/* returns true if the variable does not exist, in which case returnValue is the default Value */
+bool getVariable(Variables *const variables, const char *const name, Value *const returnValue) {
+	uint16 slot;
+	if(variables_find(variables, name, &slot)) {
 		*returnValue = defaultValue;
 		return true;
 	}
-	*returnValue = var->value;
+	*returnValue = getVariableAt(variables, slot);
 	return false;
 }
 
 /* Lists */
 
-static UT_icd value_icd = {sizeof(Value), NULL, (ctor_f*)value_copy, (dtor_f*)value_dtor};
+/*
+	A list is stored in one of three ways, depending on what is in it. When every item is a
+	number, the list is a packed column of doubles, and when every item is a string, it is a
+	column of strings. Anything else, like a list mixing numbers and strings or containing
+	booleans, is an array of Values. A list moves to the Value array the first time an item
+	that doesn't fit its column is put in it, and picks a column again once it is emptied.
+
+	Most big lists in projects are only numbers, so they can be searched without checking
+	the type of each item, and the search can compare several doubles at a time.
+
+	However they are stored, the items are kept in a ring buffer, so adding or deleting an
+	item at the front of a list is as cheap as at the end. That is what lists used as queues
+	do ("add to end", "delete 1"). Inserting or deleting anywhere else moves the items on
+	whichever side of it has fewer.
+
+	Clones start with the same lists as the sprite they are cloned from, but most never
+	change most of them, so instead of being copied, the buffer of items is shared between
+	the copies of a list (see copyLists), and a list only gets its own copy of the items
+	right before it is changed while they are shared.
+*/
+
+static const ubyte itemSizes[] = {
+	[LIST_FLOATING] = sizeof(double),
+	[LIST_STRING] = sizeof(char*),
+	[LIST_GENERIC] = sizeof(Value)
+};
+
+/* address of the item at index, which must be less than the capacity of the list */
+static inline void* slot(const List *const list, const uint32 index) {
+	return (char*)list->items->data + ((list->head + index) & (list->capacity - 1))*itemSizes[list->storage];
+}
+
+#define floatingAt(list, index) ((double*)slot(list, index))
+#define stringAt(list, index) ((char**)slot(list, index))
+#define valueAt(list, index) ((Value*)slot(list, index))
+
+static inline void moveItem(List *const list, const uint32 to, const uint32 from) {
+	memcpy(slot(list, to), slot(list, from), itemSizes[list->storage]);
+}
+
+/* Gets an item as a Value. If it is a string, the Value shares it with the list. */
+static inline Value itemAt(const List *const list, const uint32 index) {
+	Value r;
+	switch(list->storage) {
+	case LIST_FLOATING:
+		r.type = FLOATING;
+		r.data.floating = *floatingAt(list, index);
+		break;
+	case LIST_STRING:
+		r.type = STRING;
+		r.data.string = *stringAt(list, index);
+		break;
+	default:
+		r = *valueAt(list, index);
+	}
+	return r;
+}
+
+/* Copies a value into the item at index. The list's storage must already be able to hold it. */
+static inline void storeItem(List *const list, const uint32 index, const Value *const value) {
+	switch(list->storage) {
+	case LIST_FLOATING:
+		*floatingAt(list, index) = value->data.floating;
+		break;
+	case LIST_STRING:
+		*stringAt(list, index) = strdup(value->data.string);
+		break;
+	default:
+		value_copy(valueAt(list, index), (Value*)value);
+	}
+}
+
+/* frees anything that the item at index owns */
+static inline void freeItem(List *const list, const uint32 index) {
+	switch(list->storage) {
+	case LIST_STRING:
+		free(*stringAt(list, index));
+		break;
+	case LIST_GENERIC:
+		value_dtor(valueAt(list, index));
+		break;
+	}
+}
+
+static struct ListItems* allocItems(const uint32 capacity, const ubyte storage) {
+	struct ListItems *const items = malloc(sizeof(struct ListItems) + capacity*itemSizes[storage]);
+	if(items == NULL) {
+		puts("[ERROR]Could not allocate items of list.");
+		return NULL;
+	}
+	items->refCount = 1;
+	return items;
+}
+
+/* lets go of the list's items, freeing them if no other list shares them */
+static void releaseItems(List *const list) {
+	if(list->items != NULL && --list->items->refCount == 0) {
+		if(list->storage != LIST_FLOATING) {
+			for(uint32 i = 0; i < list->length; ++i)
+				freeItem(list, i);
+		}
+		free(list->items);
+	}
+	list->items = NULL;
+	list->head = list->length = list->capacity = 0;
+}
+
+/* Gives the list its own copy of its items if they are shared with another list, so they
+	 can be changed. Returns true if they couldn't be copied. */
+static bool unshare(List *const list) {
+	if(list->items == NULL || list->items->refCount == 1)
+		return false;
+	struct ListItems *const items = allocItems(list->capacity, list->storage);
+	if(items == NULL)
+		return true;
+	List copy = *list; // the copy's items start at the start of the buffer
+	copy.items = items;
+	copy.head = 0;
+	for(uint32 i = 0; i < list->length; ++i) {
+		const Value item = itemAt(list, i);
+		storeItem(&copy, i, &item);
+	}
+	--list->items->refCount;
+	list->items = items;
+	list->head = 0;
+	return false;
+}
+
+/* Makes sure there is room for one more item. Returns true if there isn't and could not be. */
+static bool reserve(List *const list) {
+	if(list->length < list->capacity)
+		return false;
+	const uint32 newCapacity = list->capacity == 0 ? 8 : list->capacity*2;
+	const size_t size = itemSizes[list->storage];
+	struct ListItems *const items = allocItems(newCapacity, list->storage);
+	if(items == NULL)
+		return true;
+	if(list->capacity != 0) { // move the items to the start of the new buffer, in order
+		const uint32 nBeforeEnd = list->capacity - list->head; // the list is full, so this is the number of items from the head to the end of the buffer
+		memcpy(items->data, (char*)list->items->data + list->head*size, nBeforeEnd*size);
+		memcpy((char*)items->data + nBeforeEnd*size, list->items->data, list->head*size);
+	}
+	free(list->items);
+	list->items = items;
+	list->head = 0;
+	list->capacity = newCapacity;
+	return false;
+}
+
+/* Makes an unset item at index by moving the items before or after it, whichever there are
+	 fewer of. Returns true if there wasn't room for it. */
+static bool openGap(List *const list, const uint32 index) {
+	if(reserve(list))
+		return true;
+	if(index < list->length/2) {
+		list->head = (list->head - 1) & (list->capacity - 1);
+		for(uint32 i = 0; i < index; ++i)
+			moveItem(list, i, i+1);
+	}
+	else {
+		for(uint32 i = list->length; i > index; --i)
+			moveItem(list, i, i-1);
+	}
+	++list->length;
+	return false;
+}
+
+/* takes out the item at index, which must already be freed, by moving the items before or after it, whichever there are fewer of */
+static void closeGap(List *const list, const uint32 index) {
+	if(index < list->length/2) {
+		for(uint32 i = index; i != 0; --i)
+			moveItem(list, i, i-1);
+		list->head = (list->head + 1) & (list->capacity - 1);
+	}
+	else {
+		for(uint32 i = index; i+1 < list->length; ++i)
+			moveItem(list, i, i+1);
+	}
+	--list->length;
+}
+
+static inline ubyte storageForType(const enum Type type) {
+	switch(type) {
+	case FLOATING: return LIST_FLOATING;
+	case STRING: return LIST_STRING;
+	default: return LIST_GENERIC;
+	}
+}
+
+/* Moves the items of a column into an array of Values, without copying any strings.
+	 Returns true if the array could not be allocated. */
+static bool toGeneric(List *const list) {
+	struct ListItems *const items = allocItems(list->capacity, LIST_GENERIC);
+	if(items == NULL)
+		return true;
+	Value *const values = (Value*)items->data;
+	for(uint32 i = 0; i < list->length; ++i)
+		values[i] = itemAt(list, i);
+	free(list->items);
+	list->items = items;
+	list->head = 0;
+	list->storage = LIST_GENERIC;
+	return false;
+}
+
+/* Makes sure that a value of the given type can be stored in the list. The list's items
+	 must not be shared. Returns true if the value can't be stored. */
+static bool prepareFor(List *const list, const enum Type type) {
+	const ubyte storage = storageForType(type);
+	if(list->storage == storage || (list->storage == LIST_GENERIC && list->length != 0))
+		return false;
+	if(list->length == 0) { // an empty list can change to any storage for free
+		if(itemSizes[storage] != itemSizes[list->storage])
+			releaseItems(list);
+		list->head = 0;
+		list->storage = storage;
+		return false;
+	}
+	return toGeneric(list);
+}
+
+/*
+	A list that is searched with "contains" over and over, which usually means it is being
+	used as a set, gets an index of its items (see listindex.c), so the searches don't need
+	to go through the list. The index is built once a list of at least LIST_INDEX_MIN_LENGTH
+	items has been searched LIST_INDEX_AFTER_SCANS times, and from then on it is updated by
+	every change to the list. Keeping it up to date costs something on every change though,
+	so if the list has been changed more times than it has items without being searched, the
+	index is dropped.
+*/
+
+#define LIST_INDEX_MIN_LENGTH 128
+#define LIST_INDEX_AFTER_SCANS 8
+
+static void dropIndex(List *const list) {
+	if(list->index != NULL) {
+		listIndex_done(list->index);
+		free(list->index);
+		list->index = NULL;
+	}
+	list->nScans = 0;
+}
+
+/* returns true if the list's index has been kept up to date for long enough without being used */
+static inline bool indexUnused(List *const list) {
+	return ++list->nUpdates > list->length + LIST_INDEX_MIN_LENGTH;
+}
+
+/* updates the list's index, if it has one, for an item being put in the list */
+static inline void indexAdd(List *const list, const Value *const item) {
+	if(list->index != NULL && (indexUnused(list) || listIndex_add(list->index, item)))
+		dropIndex(list);
+}
+
+/* updates the list's index, if it has one, for the item at the given position being taken out of the list */
+static inline void indexRemove(List *const list, const uint32 i) {
+	if(list->index != NULL) {
+		if(indexUnused(list))
+			dropIndex(list);
+		else {
+			const Value item = itemAt(list, i);
+			listIndex_remove(list->index, &item);
+		}
+	}
+}
+
+/* Returns the list's index to search instead of the list, building it if the list has
+	 been searched enough to be worth it, or NULL if the list should be searched. */
+static const ListIndex* containsIndex(List *const list) {
+	if(list->index != NULL) {
+		list->nUpdates = 0;
+		return list->index;
+	}
+	const uint32 len = list->length;
+	if(len < LIST_INDEX_MIN_LENGTH || ++list->nScans < LIST_INDEX_AFTER_SCANS)
+		return NULL;
+
+	list->index = malloc(sizeof(ListIndex));
+	if(list->index == NULL || listIndex_init(list->index, len)) {
+		free(list->index);
+		list->index = NULL;
+		list->nScans = 0;
+		return NULL;
+	}
+	list->nUpdates = 0;
+	for(uint32 i = 0; i < len; ++i) {
+		const Value item = itemAt(list, i);
+		if(listIndex_add(list->index, &item)) {
+			dropIndex(list);
+			return NULL;
+		}
+	}
+	return list->index;
+}
+
+/*
+	Reading a list as a string (the list reporter) joins all of its items, with spaces
+	between them unless every item is a single character. Scripts often read a list like
+	that over and over, e.g. to show a board, so the string is kept with the list until the
+	list changes. Adding an item to the end of the list just adds it to the end of the
+	string, unless it changes whether the items are joined with spaces.
+*/
+
+/* Makes sure the list's contents string has room for length characters and a terminator.
+	 Returns true if it doesn't and could not be given it. */
+static bool reserveContents(struct ListContents *const contents, const size_t length) {
+	if(length < contents->capacity)
+		return false;
+	size_t newCapacity = contents->capacity == 0 ? 64 : contents->capacity;
+	while(newCapacity <= length)
+		newCapacity *= 2;
+	char *const string = realloc(contents->string, newCapacity);
+	if(string == NULL) {
+		puts("[ERROR]Could not allocate list contents string.");
+		return true;
+	}
+	contents->string = string;
+	contents->capacity = newCapacity;
+	return false;
+}
+
+/* Appends a string to the contents being built. Returns true if there wasn't room for it. */
+static inline bool appendToContents(struct ListContents *const contents, const char *const str, const size_t len) {
+	if(reserveContents(contents, contents->length + len))
+		return true;
+	memcpy(contents->string + contents->length, str, len);
+	contents->length += len;
+	return false;
+}
+
+static bool buildContents(List *const list) {
+	struct ListContents *const contents = &list->contents;
+	contents->length = contents->nChars = 0;
+	if(reserveContents(contents, 0))
+		return true;
+	bool allSingle = true; // whether every item is exactly one character
+	for(uint32 i = 0; i < list->length; ++i) {
+		const Value item = itemAt(list, i);
+		const char *str;
+		const size_t len = toStringView(&item, &str);
+		contents->nChars += len;
+		allSingle &= len == 1;
+		if(appendToContents(contents, str, len) || appendToContents(contents, " ", 1))
+			return true;
+	}
+	if(contents->nChars == list->length) { // if the items are joined without spaces
+		if(allSingle) { // take out the spaces
+			for(uint32 i = 1; i < list->length; ++i)
+				contents->string[i] = contents->string[i*2];
+			contents->length = list->length;
+		}
+		else { // some empty strings and longer strings add up to one character per item, so the spaces aren't where the characters were
+			contents->length = 0;
+			for(uint32 i = 0; i < list->length; ++i) {
+				const Value item = itemAt(list, i);
+				const char *str;
+				const size_t len = toStringView(&item, &str);
+				appendToContents(contents, str, len); // there is already room from above
+			}
+		}
+	}
+	else
+		--contents->length; // take off the last space
+	contents->string[contents->length] = '\0';
+	contents->valid = true;
+	return false;
+}
+
+/* updates the list's contents string, if it is valid, for an item added to the end of the list */
+static void contentsAppended(List *const list) {
+	struct ListContents *const contents = &list->contents;
+	if(!contents->valid)
+		return;
+	const uint32 oldLength = list->length - 1;
+	const Value item = itemAt(list, oldLength);
+	const char *str;
+	const size_t len = toStringView(&item, &str);
+	const bool wasJoined = contents->nChars == oldLength, isJoined = contents->nChars + len == list->length;
+	contents->nChars += len;
+	if(oldLength == 0) // one item is the same either way
+		contents->length = 0;
+	else if(wasJoined != isJoined) {
+		contents->valid = false;
+		return;
+	}
+	else if(!isJoined && appendToContents(contents, " ", 1)) {
+		contents->valid = false;
+		return;
+	}
+	if(appendToContents(contents, str, len) || reserveContents(contents, contents->length)) {
+		contents->valid = false;
+		return;
+	}
+	contents->string[contents->length] = '\0';
+}
+
+#define invalidateContents(list) ((list)->contents.valid = false)
 
 void list_init(List **lists, List *const list, const char *const name, size_t nameLen) {
 	list->name = extractString(name, &nameLen);
-	utarray_init(&list->contents, &value_icd);
+	list->items = NULL;
+	list->head = list->length = list->capacity = 0;
+	list->storage = LIST_FLOATING;
+	list->index = NULL;
+	list->nScans = 0;
+	list->contents.string = NULL;
+	list->contents.capacity = 0;
+	list->contents.valid = false;
 	HASH_ADD_KEYPTR(hh, *lists, list->name, nameLen, list);
 }
 
-UT_array* list_new(List **lists, const char *const name, const size_t nameLen) {
+List* list_new(List **lists, const char *const name, const size_t nameLen) {
 	List *const list = malloc(sizeof(List));
 	if(list == NULL) {
 		printf("[ERROR]Could not allocate list \"%s\"\n", name);
 		return NULL;
 	}
 	list_init(lists, list, name, nameLen);
-	return &list->contents;
+	return list;
 }
 
 void freeLists(List **lists) {
 	List *list, *tmp;
 	HASH_ITER(hh, *lists, list, tmp) { // delete each list from the hash table
-		utarray_done(&list->contents);
+		releaseItems(list);
+		dropIndex(list);
+		free(list->contents.string);
 		//printf("FREE:   %p\n", current);
 		HASH_DEL(*lists, list);
 		free(list); // free each list
@@ -158,95 +774,222 @@ List* copyLists(const List *const *const lists) {
 	const List *src = *lists;
 	for(uint16 i = HASH_COUNT(*lists); i != 0; --i) {
 		List *new = malloc(sizeof(List));
-		size_t nameLen = 0;
-		new->name = extractString(src->name, &nameLen);
-		utarray_init(&new->contents, &value_icd);
-		utarray_inserta(&new->contents, &src->contents, 0);
-		HASH_ADD_KEYPTR(hh, newLists, new->name, nameLen, new);
+		new->name = src->name; // names of lists are never freed, so they can be shared too
+		new->items = src->items; // share the items until one of the lists changes
+		if(new->items != NULL)
+			++new->items->refCount;
+		new->head = src->head;
+		new->length = src->length;
+		new->capacity = src->capacity;
+		new->storage = src->storage;
+		new->index = NULL;
+		new->nScans = 0;
+		new->contents.string = NULL;
+		new->contents.capacity = 0;
+		new->contents.valid = false;
+		HASH_ADD_KEYPTR(hh, newLists, new->name, src->hh.keylen, new);
 		src = src->hh.next;
 	}
 	return newLists;
 }
 
-bool getListContents(List **lists, const char *const name, UT_array **const returnContents) {
+/* Lets go of the items of every list, but keeps the lists, so that a clone that is being
+	 reused can share the items of another sprite's lists again with recopyLists. */
+void clearLists(List **lists) {
+	List *list;
+	for(list = *lists; list != NULL; list = list->hh.next) {
+		releaseItems(list);
+		dropIndex(list);
+		invalidateContents(list);
+	}
+}
+
+/* Makes cleared lists the same as the lists they were copied from again, like copyLists,
+	 but without making new Lists. If the lists don't match, because one of the sprites made
+	 a new list while running, they are just freed and copied again. */
+void recopyLists(List **dst, const List *const *const src) {
+	const List *s = *src;
+	List *d = *dst;
+	if(HASH_COUNT(*dst) == HASH_COUNT(*src)) {
+		for(; s != NULL; s = s->hh.next, d = d->hh.next) {
+			if(d->name != s->name) // the names of copies are shared with the original
+				break;
+		}
+	}
+	if(s != NULL) {
+		freeLists(dst);
+		*dst = copyLists(src);
+		return;
+	}
+
+	for(s = *src, d = *dst; s != NULL; s = s->hh.next, d = d->hh.next) {
+		d->items = s->items;
+		if(d->items != NULL)
+			++d->items->refCount;
+		d->head = s->head;
+		d->length = s->length;
+		d->capacity = s->capacity;
+		d->storage = s->storage;
+	}
+}
+
+bool getList(List **lists, const char *const name, List **const returnList) {
 	List *list;
 	HASH_FIND_STR(*lists, name, list);
 	if(list == NULL)
 		return true;
-	*returnContents = &list->contents;
+	*returnList = list;
 	return false;
 }
 
-Value listGetFirst(const UT_array *const list) {
-	if(utarray_len(list) == 0)
+uint32 listLength(const List *const list) {
+	return list->length;
+}
+
+/* Gets the list as a string, the way the list reporter shows it. The string belongs to the
+	 list, and is only valid until the list is changed. Returns NULL if there wasn't memory
+	 for it. */
+const char* listGetContents(List *const list) {
+	if(!list->contents.valid && buildContents(list))
+		return NULL;
+	return list->contents.string;
+}
+
+Value listGetFirst(const List *const list) {
+	if(list->length == 0)
 		return defaultValue;
 	else
-		return *(Value*)utarray_front(list);
+		return itemAt(list, 0);
 }
 
-Value listGetLast(const UT_array *const list) {
-	if(utarray_len(list) == 0)
+Value listGetLast(const List *const list) {
+	if(list->length == 0)
 		return defaultValue;
 	else
-		return *(Value*)utarray_back(list);
+		return itemAt(list, list->length-1);
 }
 
-Value listGet(const UT_array *const list, const uint32 index) {
-	if(utarray_len(list) > index)
-		return *(Value*)utarray_eltptr(list, index);
+Value listGet(const List *const list, const uint32 index) {
+	if(list->length > index)
+		return itemAt(list, index);
 	else
 		return defaultValue;
 }
 
-void listAppend(UT_array *list, const Value *const value) {
-	utarray_push_back(list, (void*)value);
+void listAppend(List *list, const Value *const value) {
+	listInsert(list, value, list->length);
+}
+
+void listPrepend(List *list, const Value *const value) {
+	listInsert(list, value, 0);
 }
 
-void listPrepend(UT_array *list, const Value *const value) {
-	utarray_insert(list, (void*)value, 0);
+void listInsert(List *list, const Value *const value, const uint32 index) {
+	if(index > list->length || unshare(list) || prepareFor(list, value->type) || openGap(list, index))
+		return;
+	indexAdd(list, value);
+	storeItem(list, index, value);
+	if(index == list->length-1)
+		contentsAppended(list);
+	else
+		invalidateContents(list);
 }
 
-void listInsert(UT_array *list, const Value *const value, const uint32 index) {
-	utarray_insert(list, (void*)value, index);
+void listSetFirst(List *list, const Value *const newValue) {
+	listSet(list, newValue, 0);
 }
 
-void listSetFirst(UT_array *list, const Value *const newValue) {
-	Value *elt = (Value*)utarray_front(list);
-	value_dtor(elt);
-	*elt = *newValue;
+void listSetLast(List *list, const Value *const newValue) {
+	listSet(list, newValue, list->length-1);
 }
 
-void listSetLast(UT_array *list, const Value *const newValue) {
-	Value *elt = (Value*)utarray_back(list);
-	value_dtor(elt);
-	*elt = *newValue;
+void listSet(List *list, const Value *const newValue, const uint32 index) {
+	if(index >= list->length || unshare(list) || prepareFor(list, newValue->type))
+		return;
+	indexRemove(list, index);
+	indexAdd(list, newValue);
+	Value old = itemAt(list, index);
+	storeItem(list, index, newValue); // before releasing the old item, in case the new one is its string
+	value_dtor(&old);
+	invalidateContents(list);
 }
 
-void listSet(UT_array *list, const Value *const newValue, const uint32 index) {
-	Value *elt = (Value*)utarray_eltptr(list, index);
-	value_dtor(elt);
-	*elt = *newValue;
+void listDeleteFirst(List *list) {
+	listDelete(list, 0);
 }
 
-void listDeleteFirst(UT_array *list) {
-	utarray_erase(list, 0, 1);
+void listDeleteLast(List *list) {
+	listDelete(list, list->length-1);
 }
 
-void listDeleteLast(UT_array *list) {
-	utarray_pop_back(list);
+void listDelete(List *list, const uint32 index) {
+	if(index < list->length && !unshare(list)) {
+		indexRemove(list, index);
+		freeItem(list, index);
+		closeGap(list, index);
+		invalidateContents(list);
+	}
 }
 
-void listDelete(UT_array *list, const uint32 index) {
-	utarray_erase(list, index, 1);
+void listDeleteAll(List *list) {
+	if(list->items != NULL && list->items->refCount != 1)
+		releaseItems(list);
+	else if(list->storage != LIST_FLOATING) {
+		for(uint32 i = 0; i < list->length; ++i)
+			freeItem(list, i);
+	}
+	list->head = list->length = 0;
+	dropIndex(list);
+	invalidateContents(list);
 }
 
-void listDeleteAll(UT_array *list) {
-	utarray_clear(list);
+/* Returns the index of the first item in a column of doubles equal to floating, or len if
+	 there isn't one. This is the hot path of lists used as sets of numbers, so it compares
+	 several items at a time when SSE2 or AVX is available. */
+static uint32 findFloating(const double *const column, const uint32 len, const double floating) {
+	uint32 i = 0;
+#if defined(__AVX__)
+	const __m256d needle = _mm256_set1_pd(floating);
+	for(; i + 8 <= len; i += 8) {
+		const __m256d a = _mm256_cmp_pd(_mm256_loadu_pd(column+i), needle, _CMP_EQ_OQ);
+		const __m256d b = _mm256_cmp_pd(_mm256_loadu_pd(column+i+4), needle, _CMP_EQ_OQ);
+		if(_mm256_movemask_pd(_mm256_or_pd(a, b)) != 0)
+			break;
+	}
+#elif defined(__SSE2__)
+	const __m128d needle = _mm_set1_pd(floating);
+	for(; i + 8 <= len; i += 8) {
+		const __m128d a = _mm_or_pd(_mm_cmpeq_pd(_mm_loadu_pd(column+i), needle), _mm_cmpeq_pd(_mm_loadu_pd(column+i+2), needle));
+		const __m128d b = _mm_or_pd(_mm_cmpeq_pd(_mm_loadu_pd(column+i+4), needle), _mm_cmpeq_pd(_mm_loadu_pd(column+i+6), needle));
+		if(_mm_movemask_pd(_mm_or_pd(a, b)) != 0)
+			break;
+	}
+#endif
+	for(; i < len; ++i) { // finds the match within the block of 8 that had one, or goes through the rest of the column
+		if(column[i] == floating)
+			return i;
+	}
+	return len;
 }
 
-bool listContainsFloating(const UT_array *const list, const double floating) {
-	for(uint32 i = 0; i < utarray_len(list); ++i) {
-		Value *v = (Value*)utarray_eltptr(list, i);
+bool listContainsFloating(List *const list, const double floating) {
+	if(list->storage == LIST_STRING)
+		return false;
+	const ListIndex *const index = containsIndex(list);
+	if(index != NULL) {
+		const Value item = {{.floating = floating}, FLOATING};
+		return listIndex_contains(index, &item);
+	}
+	const uint32 len = list->length;
+	if(len == 0) // an empty list might not have any items to take the column of
+		return false;
+	if(list->storage == LIST_FLOATING) { // the column can wrap around the end of the ring buffer, so search it in two parts
+		const double *const column = (const double*)list->items->data;
+		const uint32 nBeforeEnd = len < list->capacity - list->head ? len : list->capacity - list->head;
+		return findFloating(column + list->head, nBeforeEnd, floating) != nBeforeEnd || findFloating(column, len - nBeforeEnd, floating) != len - nBeforeEnd;
+	}
+	for(uint32 i = 0; i < len; ++i) {
+		const Value *v = valueAt(list, i);
 		if(v->type == FLOATING) { // based on the fact that before a value is stored, it is simplified to a float if possible, so the only strings will be ones that can't be numbers
 			if(v->data.floating == floating)
 				return true;
@@ -255,9 +998,16 @@ bool listContainsFloating(const UT_array *const list, const double floating) {
 	return false;
 }
 
-bool listContainsBoolean(const UT_array *const list, const bool boolean) {
-	for(uint32 i = 0; i < utarray_len(list); ++i) {
-		Value *v = (Value*)utarray_eltptr(list, i);
+bool listContainsBoolean(List *const list, const bool boolean) {
+	if(list->storage != LIST_GENERIC)
+		return false;
+	const ListIndex *const index = containsIndex(list);
+	if(index != NULL) {
+		const Value item = {{.boolean = boolean}, BOOLEAN};
+		return listIndex_contains(index, &item);
+	}
+	for(uint32 i = 0; i < list->length; ++i) {
+		const Value *v = valueAt(list, i);
 		if(v->type == BOOLEAN) {
 			if(v->data.boolean == boolean)
 				return true;
@@ -266,9 +1016,25 @@ bool listContainsBoolean(const UT_array *const list, const bool boolean) {
 	return false;
 }
 
-bool listContainsString(const UT_array *const list, const char *const string) {
-	for(uint32 i = 0; i < utarray_len(list); ++i) {
-		Value *v = (Value*)utarray_eltptr(list, i);
+bool listContainsString(List *const list, const char *const string) {
+	if(list->storage == LIST_FLOATING)
+		return false;
+	const ListIndex *const index = containsIndex(list);
+	if(index != NULL) {
+		const Value item = {{.string = (char*)string}, STRING};
+		return listIndex_contains(index, &item);
+	}
+	const uint32 len = list->length;
+	if(list->storage == LIST_STRING) {
+		for(uint32 i = 0; i < len; ++i) {
+			const char *const s = *stringAt(list, i);
+			if(s[0] == string[0] && strcmp(s, string) == 0)
+				return true;
+		}
+		return false;
+	}
+	for(uint32 i = 0; i < len; ++i) {
+		const Value *v = valueAt(list, i);
 		if(v->type == STRING) {
 			if(strcmp(v->data.string, string) == 0)
 				return true;
@@ -1,38 +1,53 @@
 #pragma once
 
-typedef struct Variable Variable;
+typedef struct Variables Variables;
 typedef struct List List;
+typedef struct Utf8Index Utf8Index;
 
-extern void variable_init(Variable **variables, Variable *const variable, const char *const name, const size_t nameLen, const Value *const value);
-extern void variable_new(Variable **variables, const char *const name, const size_t nameLen, const Value *const value);
-extern void freeVariables(Variable **variables);
-extern Variable* copyVariables(const Variable *const *const variables);
-extern bool setVariable(Variable **variables, const char *name, const Value *const newValue);
-extern bool getVariable(Variable **variables, const char *const name, Value *const returnValue);
+#define NO_VARIABLE UINT16_MAX // the slot variable_new returns when it fails
+
+extern void variables_init(Variables *const variables);
+extern void variables_free(Variables *const variables);
+extern void variables_clear(Variables *const variables);
+extern void variables_copy(Variables *const dst, const Variables *const src);
+extern bool variables_find(const Variables *const variables, const char *const name, uint16 *const slot);
+extern uint16 variable_new(Variables *const variables, const char *const name, size_t nameLen, const Value *const value);
+
+extern Value getVariableAt(Variables *const variables, const uint16 slot);
+extern void setVariableAt(Variables *const variables, const uint16 slot, const Value *const newValue);
+extern void appendToVariableAt(Variables *const variables, const uint16 slot, const char *const str, const size_t len);
+extern Value getVariableUtf8IndexAt(Variables *const variables, const uint16 slot, const Utf8Index **const index);
+
+extern bool getVariable(Variables *const variables, const char *const name, Value *const returnValue);
 
 extern void list_init(List **lists, List *list, const char *const name, const size_t nameLen);
-extern UT_array* list_new(List **lists, const char *const name, const size_t nameLen);
+extern List* list_new(List **lists, const char *const name, const size_t nameLen);
 extern void freeLists(List **lists);
 extern List *copyLists(const List *const *const Lists);
-extern bool getListContents(List **lists, const char *const name, UT_array **const returnContents);
+extern void clearLists(List **lists);
+extern void recopyLists(List **dst, const List *const *const src);
+extern bool getList(List **lists, const char *const name, List **const returnList);
+
+extern uint32 listLength(const List *const list);
+extern const char* listGetContents(List *const list);
 
-extern Value listGetFirst(const UT_array *const list);
-extern Value listGetLast(const UT_array *const list);
-extern Value listGet(const UT_array *const list, const uint32 index);
+extern Value listGetFirst(const List *const list);
+extern Value listGetLast(const List *const list);
+extern Value listGet(const List *const list, const uint32 index);
 
-extern void listAppend(UT_array *list, const Value *const value);
-extern void listPrepend(UT_array *list, const Value *const value);
-extern void listInsert(UT_array *list, const Value *const value, const uint32 index);
+extern void listAppend(List *list, const Value *const value);
+extern void listPrepend(List *list, const Value *const value);
+extern void listInsert(List *list, const Value *const value, const uint32 index);
 
-extern void listSetFirst(UT_array *list, const Value *const newValue);
-extern void listSetLast(UT_array *list, const Value *const newValue);
-extern void listSet(UT_array *list, const Value *const newValue, const uint32 index);
+extern void listSetFirst(List *list, const Value *const newValue);
+extern void listSetLast(List *list, const Value *const newValue);
+extern void listSet(List *list, const Value *const newValue, const uint32 index);
 
-extern void listDeleteFirst(UT_array *list);
-extern void listDeleteLast(UT_array *list);
-extern void listDelete(UT_array *list, const uint32 index);
-extern void listDeleteAll(UT_array *list);
+extern void listDeleteFirst(List *list);
+extern void listDeleteLast(List *list);
+extern void listDelete(List *list, const uint32 index);
+extern void listDeleteAll(List *list);
 
-extern bool listContainsFloating(const UT_array *const list, const double floating);
-extern bool listContainsBoolean(const UT_array *const list, const bool boolean);
-extern bool listContainsString(const UT_array *const list, const char *const string);
+extern bool listContainsFloating(List *const list, const double floating);
+extern bool listContainsBoolean(List *const list, const bool boolean);
+extern bool listContainsString(List *const list, const char *const string);
@@ -2,17 +2,51 @@
 	Zip Loader
 	  zip_loader.c
 
-	This module reads SB2s (actually ZIP archives) produced by the Scratch editor, and it
-	returns an array of "resources" and the project.json. A resource is represented by a
-	struct Resource and can either be a handle a texture on the GPU produced from an image,
-	or a (TODO: SVGs and WAVs). They are returned in an array, because the project.json
-	references the resources with indices, making it easy for the parser to organize and
-	load the resources into the peripherals.
-
-	All of the actual decompression and parsing of the zip archives is done by minizip and
-	zlib. This module just pulls out the files and processes them one at a time.
+	This module reads SB2s (actually ZIP archives) produced by the Scratch editor. It gives
+	the project.json to the loader, and then gives out "resources" while the project runs.
+	A resource is represented by a struct Resource and can either be a handle a texture on
+	the GPU produced from an image, or a (TODO: SVGs and WAVs). They are looked up by index,
+	because the project.json references the resources with indices.
+
+	The SB2 is mapped into memory rather than read through stdio. minizip is only used to go
+	through the central directory of the archive, which it reads out of the mapping through
+	the functions in zlib_filefunc_def. Once the entries are known, their data is used right
+	where it is in the mapping: stored files are never copied at all, and compressed files
+	are inflated by zlib straight from the mapping into the buffer they end up in.
+
+	Turning an image into a texture is done in two steps: decoding it into a bitmap, and
+	uploading the bitmap to the GPU. Decoding is most of the work, and most projects have
+	plenty of costumes that are never shown, or not until long after the project starts, so
+	nothing is decoded while loading. Instead, the mapping stays open for as long as the
+	project runs (until closeSB2), and a resource is read the first time it is used, by
+	getResource. To keep that from stalling the project, resources that are likely to be
+	used soon can be given to prefetchResource, which queues them to be decoded by a pool of
+	prefetcher threads. Once the project has started, streamResources has the prefetchers
+	go on to read every other resource whenever nothing is queued, and resourceReady lets
+	a script wait for the one resource it needs, without holding up the rest of the
+	project. Uploading has to be done on the thread with the OpenGL context, so it is left
+	for getResource, or uploadResources, which uploads whatever the prefetchers have read.
+
+	Projects often have the same file in them more than once, like when a sprite has been
+	duplicated. Entries with the same contents are found when the SB2 is opened, and every
+	one of them is given to the first of them (its "original"), so that a file is only
+	decoded and uploaded once, however many resources have it.
+
+	Decoded images can also be kept in an asset cache on disk, so that an image that has
+	been decoded before, by any project, doesn't have to be decoded again (see
+	asset_cache.c).
 **/
 
+#include <ctype.h>
+#ifdef _WIN32
+#include <stdio.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
 #include "SOIL2/SOIL2.h"
 
@@ -28,93 +62,691 @@
 
 #include "zip_loader.h"
 
-/*
-	Returns an array of struct Resources, or NULL if it encountered a fatal error.
-*/
-struct Resource *loadSB2(const char *const path, char **const json, size_t *const jsonLen) {
-	unzFile zip = unzOpen(path);
-	if(zip == NULL) {
-		printf("[FATAL]Could not open \"%s\" as a zip(sb2).\n", path);
+#define MAX_PREFETCHERS 4
+
+enum EntryState {
+	ENTRY_MISSING, // there is no file in the SB2 for the resource
+	ENTRY_UNREAD,
+	ENTRY_QUEUED, // waiting for a prefetcher to read it
+	ENTRY_READING, // being read by a prefetcher, or taken by getResource or uploadResources
+	ENTRY_READ, // read by a prefetcher, and waiting to be uploaded
+};
+
+/* A file in the SB2. Entries for resources stay around for as long as the SB2 is open, so
+	 that they can be read when they are first needed. */
+struct Entry {
+	size_t dataOffset; // where the data of the file starts in the SB2
+	uLong compressedSize, size;
+	uLong method; // 0 if the file is stored, Z_DEFLATED if it is compressed
+	uLong crc;
+	char fileName[16]; // "project.json" is 12 chars, and no asset will ever have a name longer than 15 chars
+	enum ResourceFormat format;
+	char hash[33]; // the MD5 the project.json names the file by, or "" if it doesn't
+	uint32 original; // the index of the first entry with the same contents, which is used instead of this one
+
+	enum EntryState state; // only changed under entriesMutex
+	bool needed; // set once resourceReady has put it at the front of the queue
+	bool loaded; // set once the resource is ready, only used by the thread with the OpenGL context
+	unsigned char *data; // the decoded bitmap, until it is uploaded (NULL if it couldn't be decoded)
+	int width, height;
+	const unsigned char *cached; // the mapping of the asset cache file data is in, if it came from there
+	size_t cachedSize;
+};
+
+static const char *sb2Path;
+static const char *assetCachePath; // NULL if there is no asset cache
+static const unsigned char *sb2; // the mapping of the whole SB2
+static size_t sb2Size;
+static struct Entry projectJson;
+static unsigned char *inflatedJson; // the project.json, if it had to be inflated
+static struct Entry *entries; // the entry of each resource, by its index
+static struct Resource *resources;
+static uint32 nResources;
+
+static SDL_mutex *entriesMutex;
+static SDL_cond *queuedCond; // signaled whenever an entry is queued, or the prefetchers should stop
+static SDL_cond *readCond; // signaled whenever a prefetcher has read an entry
+static uint32 *queue; // ring buffer of the indices of queued entries, which each go in at most twice
+static uint32 queueSize, queueHead, queueTail;
+static bool streaming; // set when the prefetchers should read every resource once the queue is empty
+static uint32 nextStreamed; // the index of the next resource to stream
+static uint32 *finished; // indices of the entries the prefetchers have read, for uploadResources
+static uint32 nFinished;
+static bool stopping; // set when the prefetchers should stop
+static SDL_Thread *prefetchers[MAX_PREFETCHERS];
+static uint32 nPrefetchers;
+
+/* Maps a whole file into memory, read-only. Returns NULL if it couldn't. */
+static const unsigned char *mapFile(const char *const path, size_t *const size) {
+#ifdef _WIN32
+	FILE *const file = fopen(path, "rb");
+	if(file == NULL)
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	const long len = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	unsigned char *const data = len > 0 ? malloc(len) : NULL;
+	if(data == NULL || fread(data, 1, len, file) != (size_t)len) {
+		free(data);
+		fclose(file);
 		return NULL;
 	}
-
-	unz_global_info zipInfo;
-	if(unzGetGlobalInfo(zip, &zipInfo) != UNZ_OK) {
-		printf("[FATAL]Could not get the global info of \"%s\".\n", path);
+	fclose(file);
+	*size = len;
+	return data;
+#else
+	const int fd = open(path, O_RDONLY);
+	if(fd == -1)
+		return NULL;
+	struct stat st;
+	if(fstat(fd, &st) == -1 || st.st_size == 0) {
+		close(fd);
 		return NULL;
 	}
-	struct Resource *res = malloc((zipInfo.number_entry-1)*sizeof(struct Resource)); // don't check for only 1 entry, because there has to be at least 2 for every valid Scratch project
-	if(res == NULL) {
-		puts("[FATAL]Out of memory: could not allocate struct Resources.");
+	void *const data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping stays after the file is closed
+	if(data == MAP_FAILED)
 		return NULL;
+	*size = st.st_size;
+	return data;
+#endif
+}
+
+static void unmapFile(const unsigned char *const data, const size_t size) {
+#ifdef _WIN32
+	(void)size;
+	free((void*)data);
+#else
+	munmap((void*)data, size);
+#endif
+}
+
+static void unmapSB2(void) {
+	if(sb2 == NULL)
+		return;
+	unmapFile(sb2, sb2Size);
+	sb2 = NULL;
+}
+
+/* The functions minizip uses to read the SB2, which read from the mapping. A stream is
+	 just how far into the mapping it is. */
+static voidpf ZCALLBACK openMapped(voidpf opaque, const char *filename, int mode) {
+	(void)opaque; (void)filename;
+	if((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER) != ZLIB_FILEFUNC_MODE_READ)
+		return NULL;
+	uLong *const pos = malloc(sizeof(uLong));
+	if(pos != NULL)
+		*pos = 0;
+	return pos;
+}
+
+static uLong ZCALLBACK readMapped(voidpf opaque, voidpf stream, void *buf, uLong size) {
+	(void)opaque;
+	uLong *const pos = stream;
+	if(size > sb2Size - *pos)
+		size = sb2Size - *pos;
+	memcpy(buf, sb2 + *pos, size);
+	*pos += size;
+	return size;
+}
+
+static uLong ZCALLBACK writeMapped(voidpf opaque, voidpf stream, const void *buf, uLong size) {
+	(void)opaque; (void)stream; (void)buf; (void)size;
+	return 0;
+}
+
+static long ZCALLBACK tellMapped(voidpf opaque, voidpf stream) {
+	(void)opaque;
+	return *(uLong*)stream;
+}
+
+static long ZCALLBACK seekMapped(voidpf opaque, voidpf stream, uLong offset, int origin) {
+	(void)opaque;
+	uLong *const pos = stream;
+	uLong base;
+	switch(origin) {
+	case ZLIB_FILEFUNC_SEEK_SET: base = 0; break;
+	case ZLIB_FILEFUNC_SEEK_CUR: base = *pos; break;
+	case ZLIB_FILEFUNC_SEEK_END: base = sb2Size; break;
+	default: return -1;
 	}
+	if(base + offset > sb2Size)
+		return -1;
+	*pos = base + offset;
+	return 0;
+}
 
-	int unzReturn;
-	if(unzGoToFirstFile(zip) != UNZ_OK) {
-		printf("[FATAL]Could not go to the first file in \"%s\".\n", path);
+static int ZCALLBACK closeMapped(voidpf opaque, voidpf stream) {
+	(void)opaque;
+	free(stream);
+	return 0;
+}
+
+static int ZCALLBACK errorMapped(voidpf opaque, voidpf stream) {
+	(void)opaque; (void)stream;
+	return 0;
+}
+
+static zlib_filefunc_def mappedFuncs = {openMapped, readMapped, writeMapped, tellMapped, seekMapped, closeMapped, errorMapped, NULL};
+
+/* Inflates a compressed entry from the mapping into dst, which has room for all of it.
+	 Returns true if it couldn't. */
+static bool inflateEntry(const struct Entry *const e, unsigned char *const dst) {
+	z_stream z;
+	z.next_in = (Bytef*)(sb2 + e->dataOffset);
+	z.avail_in = e->compressedSize;
+	z.next_out = dst;
+	z.avail_out = e->size;
+	z.zalloc = Z_NULL;
+	z.zfree = Z_NULL;
+	z.opaque = Z_NULL;
+	if(inflateInit2(&z, -MAX_WBITS) != Z_OK) // zip archives have raw deflate streams, without zlib headers
+		return true;
+	const int r = inflate(&z, Z_FINISH);
+	inflateEnd(&z);
+	return r != Z_STREAM_END || z.total_out != e->size || crc32(0, dst, e->size) != e->crc;
+}
+
+/* Gets the contents of the file of an entry, straight out of the mapping if it is stored,
+	 or inflated into *inflated if it is compressed, which has to be freed by the caller.
+	 Returns NULL if it couldn't. */
+static const unsigned char *entryContents(const struct Entry *const e, unsigned char **const inflated) {
+	*inflated = NULL;
+	if(e->method == 0) // if it is stored, use it right out of the mapping
+		return sb2 + e->dataOffset;
+	*inflated = malloc(e->size);
+	if(*inflated == NULL) {
+		printf("[ERROR]Out of memory: could not allocate memory for \"%s\"\n", e->fileName);
 		return NULL;
 	}
-	do {
-		unz_file_info fi;
-		static char fileName[16] = {'\0'}; // "project.json" is 12 chars, and no asset will ever have a name longer than 15 chars
-		if(unzGetCurrentFileInfo(zip, &fi, fileName, sizeof(fileName), NULL, 0, NULL, 0) != UNZ_OK) {
-			printf("[FATAL]Something went wront when getting the info for a file in the SB2. The last file accessed (if any) was \"%s\".\n", fileName);
-			return NULL;
+	if(inflateEntry(e, *inflated)) {
+		printf("[ERROR]Something when wrong when decompressing \"%s\" in the SB2.\n", e->fileName);
+		free(*inflated);
+		*inflated = NULL;
+		return NULL;
+	}
+	return *inflated;
+}
+
+#include "asset_cache.c"
+
+/* Gets the file of an entry out of the archive, and decodes it if it is an image. Images
+	 that are in the asset cache are used from there instead. */
+static void readEntry(struct Entry *const e) {
+	e->data = NULL;
+	if(e->format == BITMAP && readCachedBitmap(e))
+		return;
+	unsigned char *inflated;
+	const unsigned char *const file = entryContents(e, &inflated);
+	if(file == NULL)
+		return;
+	switch(e->format) {
+	case BITMAP: {
+		int channels;
+		e->data = SOIL_load_image_from_memory(file, e->size, &e->width, &e->height, &channels, SOIL_LOAD_RGBA);
+		if(e->data == NULL) printf("[ERROR]Could not decode \"%s\".\n", e->fileName);
+		else cacheBitmap(e);
+		break;
+	}
+	case VECTOR: case SOUND: break;
+	}
+	free(inflated);
+}
+
+/* Frees the decoded data of an entry, wherever it came from. */
+static void freeEntryData(struct Entry *const e) {
+	if(e->cached != NULL)
+		unmapFile(e->cached, e->cachedSize);
+	else if(e->data != NULL)
+		SOIL_free_image_data(e->data);
+	e->data = NULL;
+	e->cached = NULL;
+}
+
+/* Uploads a read entry into its resource, if it is an image. This has to be done on the
+	 thread with the OpenGL context. */
+static void uploadEntry(struct Entry *const e, struct Resource *const r) {
+	switch(e->format) {
+	case BITMAP:
+		r->data.textureHandle = 0;
+		if(e->data != NULL) {
+			r->metadata.dimensions.width = e->width;
+			r->metadata.dimensions.height = e->height;
+			r->data.textureHandle = SOIL_create_OGL_texture(e->data, &r->metadata.dimensions.width, &r->metadata.dimensions.height, 4, 0, SOIL_FLAG_MIPMAPS | SOIL_FLAG_TEXTURE_REPEATS | SOIL_FLAG_INVERT_Y);
+			freeEntryData(e);
 		}
+		if(r->data.textureHandle == 0) printf("[ERROR]Could not create texture for \"%s\".\n", e->fileName);
+		break;
+	case VECTOR: case SOUND: break;
+	}
+	e->loaded = true;
+}
 
-		uint32 i; bool isProjectJson;
-		if(fileName[0] == 'p')
-			isProjectJson = true;
+/* Reads the entries that are queued, and then the rest of them if they are being
+	 streamed, until it is told to stop. This is what each prefetcher runs. */
+static int prefetchEntries(void *unused) {
+	(void)unused;
+	SDL_LockMutex(entriesMutex);
+	while(!stopping) {
+		uint32 index;
+		if(queueHead != queueTail) {
+			index = queue[queueHead];
+			queueHead = (queueHead+1) % queueSize;
+			if(entries[index].state != ENTRY_QUEUED) // getResource got to it first, or it was queued twice
+				continue;
+		}
+		else if(streaming && nextStreamed < nResources) {
+			index = nextStreamed++;
+			if(entries[index].state != ENTRY_UNREAD || entries[index].original != index)
+				continue;
+		}
 		else {
-			isProjectJson = false;
-			char *ext;
-			i = strtoul(fileName, &ext, 10);
-			++ext;
-
-			if(strncmp("png", ext, 3) == 0) res[i].format = BITMAP;
-			else if(strncmp("jpg", ext, 3) == 0) res[i].format = BITMAP;
-			else { printf("[FATAL]Resource \"%s\" is in an unrecognized format.\n", fileName); return NULL; }
+			SDL_CondWait(queuedCond, entriesMutex);
+			continue;
 		}
+		struct Entry *const e = entries+index;
+		e->state = ENTRY_READING;
+		SDL_UnlockMutex(entriesMutex);
+		readEntry(e);
+		SDL_LockMutex(entriesMutex);
+		e->state = ENTRY_READ;
+		finished[nFinished++] = index;
+		SDL_CondBroadcast(readCond);
+	}
+	SDL_UnlockMutex(entriesMutex);
+	return 0;
+}
 
-		char *file = malloc(fi.uncompressed_size);
-		if(file == NULL) {
-			printf("[FATAL]Out of memory: could not allocate memory for \"%s\"\n", fileName);
-			return NULL;
+/* Finds where the data of the current file of the archive starts in the mapping, which is
+	 after its local header. Returns true if the local header is not in the mapping. */
+static bool findData(unzFile zip, const unz_file_info *const fi, size_t *const dataOffset) {
+	const unz_s *const s = (const unz_s*)zip; // unzip.c is included, so its internals can be used
+	const size_t header = s->cur_file_info_internal.offset_curfile + s->byte_before_the_zipfile;
+	if(header + SIZEZIPLOCALHEADER > sb2Size)
+		return true;
+	const unsigned char *const h = sb2 + header;
+	if(h[0] != 'P' || h[1] != 'K' || h[2] != 3 || h[3] != 4) // local header signature
+		return true;
+	const size_t nameLen = h[26] | h[27] << 8, extraLen = h[28] | h[29] << 8;
+	*dataOffset = header + SIZEZIPLOCALHEADER + nameLen + extraLen;
+	return *dataOffset > sb2Size || fi->compressed_size > sb2Size - *dataOffset;
+}
+
+/* Goes through the central directory of the archive, filling in the entry of every
+	 resource and of the project.json. Returns true if it encountered a fatal error. */
+static bool listEntries(unzFile zip) {
+	int unzReturn;
+	if(unzGoToFirstFile(zip) != UNZ_OK) {
+		printf("[FATAL]Could not go to the first file in \"%s\".\n", sb2Path);
+		return true;
+	}
+	projectJson.state = ENTRY_MISSING;
+	do {
+		struct Entry e = {.state = ENTRY_UNREAD};
+		unz_file_info fi;
+		if(unzGetCurrentFileInfo(zip, &fi, e.fileName, sizeof(e.fileName), NULL, 0, NULL, 0) != UNZ_OK) {
+			puts("[FATAL]Something went wront when getting the info for a file in the SB2.");
+			return true;
 		}
-		if(unzOpenCurrentFile(zip) != UNZ_OK) {
-			printf("[FATAL]Could not open \"%s\" in the SB2.\n", fileName);
-			return NULL;
+		if(fi.compression_method != 0 && fi.compression_method != Z_DEFLATED) {
+			printf("[FATAL]\"%s\" is compressed in a way that is not supported.\n", e.fileName);
+			return true;
 		}
-		if(unzReadCurrentFile(zip, file, fi.uncompressed_size) < 0) {
-			printf("[FATAL]Something when wrong when reading/decompressing \"%s\" in the SB2.\n", fileName);
-			return NULL;
+		if(findData(zip, &fi, &e.dataOffset)) {
+			printf("[FATAL]Could not find the data of \"%s\" in the SB2.\n", e.fileName);
+			return true;
 		}
+		e.compressedSize = fi.compressed_size;
+		e.size = fi.uncompressed_size;
+		e.method = fi.compression_method;
+		e.crc = fi.crc;
 
-		if(isProjectJson) {
-			*json = file;
-			*jsonLen = fi.uncompressed_size / sizeof(char);
+		if(e.fileName[0] == 'p') {
+			projectJson = e;
+			continue;
 		}
-		else {
-			switch(res[i].format) {
-			case BITMAP:
-				res[i].data.textureHandle = SOIL_load_OGL_texture_from_memory((unsigned char*)file, fi.uncompressed_size, 4, &res[i].metadata.dimensions.width, &res[i].metadata.dimensions.height, SOIL_FLAG_MIPMAPS | SOIL_FLAG_TEXTURE_REPEATS | SOIL_FLAG_INVERT_Y);
-				if(res[i].data.textureHandle == 0) printf("[ERROR]Could not create texture for \"%s\".\n", fileName);
-				break;
-			case VECTOR: case SOUND: break;
-			}
-			free(file);
+		char *ext;
+		const unsigned long index = strtoul(e.fileName, &ext, 10);
+		++ext;
+		if(strncmp("png", ext, 3) == 0) e.format = BITMAP;
+		else if(strncmp("jpg", ext, 3) == 0) e.format = BITMAP;
+		else { printf("[FATAL]Resource \"%s\" is in an unrecognized format.\n", e.fileName); return true; }
+		if(index >= nResources) {
+			printf("[FATAL]Resource \"%s\" does not fit in the resources of the SB2.\n", e.fileName);
+			return true;
 		}
-
+		entries[index] = e;
+		resources[index].format = e.format;
 	} while((unzReturn = unzGoToNextFile(zip)) == UNZ_OK);
 	if(unzReturn != UNZ_END_OF_LIST_OF_FILE) {
-		printf("[FATAL]Something went wrong when iterating through the files in \"%s\".\n", path);
-		return NULL;
+		printf("[FATAL]Something went wrong when iterating through the files in \"%s\".\n", sb2Path);
+		return true;
+	}
+	if(projectJson.state == ENTRY_MISSING) {
+		printf("[FATAL]There is no project.json in \"%s\".\n", sb2Path);
+		return true;
+	}
+	return false;
+}
+
+/* Orders entries by their contents. Files are compared as they are in the SB2, so a file
+	 that is stored is never the same as one that is compressed, but the Scratch editor saves
+	 every file in an SB2 the same way. */
+static int compareFiles(const struct Entry *const x, const struct Entry *const y) {
+#define COMPARE(field) if(x->field != y->field) return x->field < y->field ? -1 : 1;
+	COMPARE(crc);
+	COMPARE(size);
+	COMPARE(format);
+	COMPARE(method);
+	COMPARE(compressedSize);
+#undef COMPARE
+	return memcmp(sb2 + x->dataOffset, sb2 + y->dataOffset, x->compressedSize);
+}
+
+/* Orders the indices of entries by the contents of the entries, and then by index. */
+static int compareIndices(const void *a, const void *b) {
+	const uint32 i = *(const uint32*)a, j = *(const uint32*)b;
+	const int c = compareFiles(entries+i, entries+j);
+	return c != 0 ? c : (i > j) - (i < j);
+}
+
+/* Gives every entry the original of its contents. Entries are sorted by their contents, so
+	 that the entries with the same contents end up next to each other, and the first of
+	 them, which has the lowest index, is their original. Returns the number of entries that
+	 aren't their own original. */
+static uint32 findOriginals(void) {
+	for(uint32 i = 0; i < nResources; ++i)
+		entries[i].original = i;
+	uint32 *const sorted = malloc((nResources+1)*sizeof(uint32));
+	if(sorted == NULL) // leave everything as its own original
+		return 0;
+	uint32 nSorted = 0;
+	for(uint32 i = 0; i < nResources; ++i) {
+		if(entries[i].state != ENTRY_MISSING)
+			sorted[nSorted++] = i;
 	}
+	qsort(sorted, nSorted, sizeof(uint32), compareIndices);
 
-	if(unzCloseCurrentFile(zip) != UNZ_OK)
-		puts("[ERROR]Something went wrong when trying to close the project.json.");
+	uint32 nCopies = 0;
+	for(uint32 i = 1; i < nSorted; ++i) {
+		struct Entry *const e = entries + sorted[i];
+		const uint32 original = entries[sorted[i-1]].original;
+		if(compareFiles(e, entries+original) == 0) {
+			e->original = original;
+			++nCopies;
+		}
+	}
+	free(sorted);
+	return nCopies;
+}
+
+/* Starts the prefetchers, leaving one CPU for the thread with the OpenGL context. Without
+	 any, resources are only read when they are used. */
+static void startPrefetchers(void) {
+	entriesMutex = SDL_CreateMutex();
+	queuedCond = SDL_CreateCond();
+	readCond = SDL_CreateCond();
+	queueHead = queueTail = 0;
+	streaming = false;
+	nextStreamed = nFinished = 0;
+	stopping = false;
+	const int nCPUs = SDL_GetCPUCount();
+	nPrefetchers = nCPUs > 1 ? nCPUs - 1 : 0;
+	if(nPrefetchers > MAX_PREFETCHERS) nPrefetchers = MAX_PREFETCHERS;
+	for(uint32 i = 0; i < nPrefetchers; ++i) {
+		prefetchers[i] = SDL_CreateThread(prefetchEntries, "asset prefetcher", NULL);
+		if(prefetchers[i] == NULL) {
+			printf("[WARNING]Could not start a thread for prefetching assets: %s\n", SDL_GetError());
+			nPrefetchers = i;
+			break;
+		}
+	}
+}
+
+static void freeEntries(void) {
+	free(entries);
+	free(resources);
+	free(queue);
+	free(finished);
+	entries = NULL;
+	resources = NULL;
+	queue = NULL;
+	finished = NULL;
+}
+
+/*
+	Opens the SB2 and finds the resources in it. Decoded images are kept in the directory at
+	cachePath, unless it is NULL. Returns true if it encountered a fatal error.
+*/
+bool loadSB2(const char *const path, const char *const cachePath) {
+	sb2Path = path;
+	inflatedJson = NULL;
+	sb2 = mapFile(path, &sb2Size);
+	if(sb2 == NULL) {
+		printf("[FATAL]Could not open \"%s\".\n", path);
+		return true;
+	}
+	unzFile zip = unzOpen2(path, &mappedFuncs);
+	if(zip == NULL) {
+		printf("[FATAL]Could not open \"%s\" as a zip(sb2).\n", path);
+		unmapSB2();
+		return true;
+	}
+
+	unz_global_info zipInfo;
+	if(unzGetGlobalInfo(zip, &zipInfo) != UNZ_OK || zipInfo.number_entry < 1) {
+		printf("[FATAL]Could not get the global info of \"%s\".\n", path);
+		unzClose(zip);
+		unmapSB2();
+		return true;
+	}
+	nResources = zipInfo.number_entry-1; // every file other than the project.json is a resource
+	entries = calloc(nResources+1, sizeof(struct Entry)); // every entry starts out ENTRY_MISSING
+	resources = malloc((nResources+1)*sizeof(struct Resource));
+	queueSize = 2*nResources + 1; // one more than it can hold, so that it is never full and empty at the same time
+	queue = malloc(queueSize*sizeof(uint32));
+	finished = malloc((nResources+1)*sizeof(uint32));
+	if(entries == NULL || resources == NULL || queue == NULL || finished == NULL) {
+		puts("[FATAL]Out of memory: could not allocate struct Resources.");
+		freeEntries();
+		unzClose(zip);
+		unmapSB2();
+		return true;
+	}
+
+	const bool listFailed = listEntries(zip);
 	if(unzClose(zip) != UNZ_OK)
 		puts("[ERROR]Something went wrong when trying to close the sb2.");
+	if(listFailed) {
+		freeEntries();
+		unmapSB2();
+		return true;
+	}
+
+	const uint32 nCopies = findOriginals();
+	if(nCopies != 0)
+		printf("[INFO]%u resources are copies of other resources, and will share them\n", (unsigned)nCopies);
+	openAssetCache(cachePath);
+	startPrefetchers();
+	return false;
+}
+
+/* Gets the CRC32 of the project.json, from the central directory of the SB2, which tells
+	 whether what was parsed from it is still what is in it. */
+uint32 projectJsonCrc(void) {
+	return projectJson.crc;
+}
+
+/* Reads the project.json, which has to be given back with freeProjectJson. Returns true if
+	 it couldn't. */
+bool readProjectJson(const char **const json, size_t *const jsonLen) {
+	const unsigned char *const contents = entryContents(&projectJson, &inflatedJson);
+	if(contents == NULL)
+		return true;
+	*json = (const char*)contents;
+	*jsonLen = projectJson.size / sizeof(char);
+	return false;
+}
+
+/* Frees the project.json given by readProjectJson. */
+void freeProjectJson(void) {
+	free(inflatedJson);
+	inflatedJson = NULL;
+}
+
+/*
+	Gets a resource, reading and uploading it if this is the first time it is used. It has
+	to be called on the thread with the OpenGL context. Returns NULL if there is no such
+	resource in the SB2.
+*/
+const struct Resource *getResource(uint32 index) {
+	if(index >= nResources)
+		return NULL;
+	index = entries[index].original;
+	struct Entry *const e = entries+index;
+	if(e->loaded)
+		return resources+index;
+
+	SDL_LockMutex(entriesMutex);
+	if(e->state == ENTRY_MISSING) {
+		SDL_UnlockMutex(entriesMutex);
+		return NULL;
+	}
+	while(e->state == ENTRY_READING) // a prefetcher is already on it
+		SDL_CondWait(readCond, entriesMutex);
+	const bool read = e->state == ENTRY_READ;
+	e->state = ENTRY_READING; // keeps the prefetchers off of it if it is queued
+	SDL_UnlockMutex(entriesMutex);
+
+	if(!read)
+		readEntry(e);
+	uploadEntry(e, resources+index);
+	return resources+index;
+}
+
+/* Gives a resource the MD5 the project.json names it by, like "0123456789abcdef0123456789abcdef"
+	 out of "0123456789abcdef0123456789abcdef.png", which is what it is kept by in the asset
+	 cache. Anything that isn't an MD5 is ignored. This has to be done before the resource is
+	 prefetched or used. */
+void setResourceHash(uint32 index, const char *const hash, const size_t hashLen) {
+	if(index >= nResources || hashLen < 32 || (hashLen > 32 && hash[32] != '.'))
+		return;
+	index = entries[index].original;
+	if(entries[index].hash[0] != '\0') // copies have the same MD5, so the first one will do
+		return;
+	for(ubyte i = 0; i < 32; ++i) {
+		if(!isxdigit((unsigned char)hash[i]))
+			return;
+	}
+	memcpy(entries[index].hash, hash, 32);
+	entries[index].hash[32] = '\0';
+}
+
+/* Gets the MD5 given to a resource by setResourceHash, or NULL if it hasn't been given one. */
+const char *getResourceHash(const uint32 index) {
+	if(index >= nResources)
+		return NULL;
+	const struct Entry *const e = entries + entries[index].original;
+	return e->hash[0] != '\0' ? e->hash : NULL;
+}
+
+/* Queues a resource to be read by a prefetcher, if it hasn't been yet, so that it is ready
+	 by the time it is used. */
+void prefetchResource(uint32 index) {
+	if(nPrefetchers == 0 || index >= nResources)
+		return;
+	index = entries[index].original;
+	if(entries[index].loaded)
+		return;
+	SDL_LockMutex(entriesMutex);
+	struct Entry *const e = entries+index;
+	if(e->state == ENTRY_UNREAD) {
+		e->state = ENTRY_QUEUED;
+		queue[queueTail] = index;
+		queueTail = (queueTail+1) % queueSize;
+		SDL_CondSignal(queuedCond);
+	}
+	SDL_UnlockMutex(entriesMutex);
+}
+
+/*
+	Checks if getResource would have the resource right away, without reading it. If it
+	wouldn't, the resource is moved to the front of the queue, so that whatever needs it
+	can wait for it without waiting for everything else that has been queued. Without any
+	prefetchers, getResource always reads resources itself, so they are always ready.
+*/
+bool resourceReady(uint32 index) {
+	if(nPrefetchers == 0 || index >= nResources)
+		return true;
+	index = entries[index].original;
+	struct Entry *const e = entries+index;
+	if(e->loaded)
+		return true;
+	SDL_LockMutex(entriesMutex);
+	const enum EntryState state = e->state;
+	if((state == ENTRY_UNREAD || state == ENTRY_QUEUED) && !e->needed) {
+		e->needed = true;
+		e->state = ENTRY_QUEUED;
+		queueHead = (queueHead + queueSize - 1) % queueSize;
+		queue[queueHead] = index;
+		SDL_CondSignal(queuedCond);
+	}
+	SDL_UnlockMutex(entriesMutex);
+	return state == ENTRY_READ || state == ENTRY_MISSING;
+}
+
+/* Has the prefetchers read every resource that hasn't been read yet, whenever there is
+	 nothing queued for them. */
+void streamResources(void) {
+	if(nPrefetchers == 0)
+		return;
+	SDL_LockMutex(entriesMutex);
+	streaming = true;
+	SDL_CondBroadcast(queuedCond);
+	SDL_UnlockMutex(entriesMutex);
+}
+
+/* Uploads the resources that the prefetchers have read since the last time, so that they
+	 don't take up memory as bitmaps, and getResource doesn't have to upload them. It has to
+	 be called on the thread with the OpenGL context. */
+void uploadResources(void) {
+	if(nPrefetchers == 0)
+		return;
+	for(;;) {
+		struct Entry *e = NULL;
+		SDL_LockMutex(entriesMutex);
+		while(e == NULL && nFinished != 0) {
+			struct Entry *const f = entries + finished[--nFinished];
+			if(f->state == ENTRY_READ) { // getResource hasn't taken it
+				f->state = ENTRY_READING;
+				e = f;
+			}
+		}
+		SDL_UnlockMutex(entriesMutex);
+		if(e == NULL)
+			return;
+		uploadEntry(e, resources + (e - entries));
+	}
+}
+
+/* Stops the prefetchers, frees everything that is left of the resources and closes the
+	 SB2. The textures that were made are left to the OpenGL context. */
+void closeSB2(void) {
+	SDL_LockMutex(entriesMutex);
+	stopping = true;
+	SDL_CondBroadcast(queuedCond);
+	SDL_UnlockMutex(entriesMutex);
+	for(uint32 i = 0; i < nPrefetchers; ++i)
+		SDL_WaitThread(prefetchers[i], NULL);
+	nPrefetchers = 0;
+	SDL_DestroyCond(queuedCond);
+	SDL_DestroyCond(readCond);
+	SDL_DestroyMutex(entriesMutex);
 
-	return res;
+	for(uint32 i = 0; i < nResources; ++i)
+		freeEntryData(entries+i);
+	freeEntries();
+	nResources = 0;
+	freeProjectJson();
+	unmapSB2();
 }
@@ -21,4 +21,15 @@ struct Resource {
 	} metadata;
 };
 
-extern struct Resource *loadSB2(const char *const path, char **const json, size_t *const jsonLen);
+extern bool loadSB2(const char *const path, const char *const cachePath);
+extern bool readProjectJson(const char **const json, size_t *const jsonLen);
+extern void freeProjectJson(void);
+extern uint32 projectJsonCrc(void);
+extern void setResourceHash(const uint32 index, const char *const hash, const size_t hashLen);
+extern const char *getResourceHash(const uint32 index);
+extern const struct Resource *getResource(const uint32 index);
+extern void prefetchResource(const uint32 index);
+extern bool resourceReady(const uint32 index);
+extern void streamResources(void);
+extern void uploadResources(void);
+extern void closeSB2(void);